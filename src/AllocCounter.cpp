@@ -0,0 +1,50 @@
+//  Heap allocation counter - see AllocCounter.h
+//
+
+#include "AllocCounter.h"
+
+#ifdef SPACELANDER_COUNT_ALLOCS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size) {
+	allocations++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+void operator delete(void* p) noexcept {
+	free(p);
+}
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+size_t allocCount() {
+	return allocations;
+}
+bool allocCounting() {
+	return true;
+}
+
+#else
+
+size_t allocCount() {
+	return 0;
+}
+bool allocCounting() {
+	return false;
+}
+
+#endif
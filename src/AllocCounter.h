@@ -0,0 +1,10 @@
+#pragma once
+//  Heap allocation counter, used to check that the per frame octree queries do
+//  not allocate.  Counting replaces the global operator new, so it is only
+//  compiled in when SPACELANDER_COUNT_ALLOCS is defined.
+//
+
+#include <cstddef>
+
+size_t allocCount();	// heap allocations so far, always 0 when counting is off
+bool allocCounting();	// true when built with SPACELANDER_COUNT_ALLOCS
@@ -0,0 +1,1188 @@
+//  Octree benchmarks - see Benchmark.h
+//
+
+#include "Benchmark.h"
+#include "AllocCounter.h"
+#include "QueryExecutor.h"
+#include "HeightGrid.h"
+#include "ParticlePool.h"
+#include "ParticleCustom.h"
+#include "ParticleRenderer.h"
+#include "ParticleCollider.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+// a failed check is counted for runBenchmarks(), and printed as FAIL or
+// DIFFERENT where it happens
+//
+static int numFailures = 0;
+
+static bool check(bool ok) {
+	if (!ok) numFailures++;
+	return ok;
+}
+
+static double elapsedMicros(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+// random downward rays and lander sized boxes over the terrain's XZ extent
+//
+static void makeQueries(const Box& bounds, int n, vector<Ray>& rays, vector<Box>& boxes) {
+	Vector3 min = bounds.parameters[0];
+	Vector3 max = bounds.parameters[1];
+	float size = (max.x() - min.x()) * 0.02;
+	for (int i = 0; i < n; i++) {
+		float x = ofRandom(min.x(), max.x());
+		float z = ofRandom(min.z(), max.z());
+		float y = ofRandom(min.y(), max.y());
+		rays.push_back(Ray(Vector3(x, max.y() + 10, z), Vector3(0, -1, 0)));
+		boxes.push_back(Box(Vector3(x - size, y - size, z - size), Vector3(x + size, y + size, z + size)));
+	}
+}
+
+// true when the layouts may disagree about vertex i.  The recursive build
+// copies a vertex lying on a split plane into every child box it touches,
+// and loses one that rounding leaves outside all of them (the child boxes
+// do not quite reach the parent's max face); the flat build puts every
+// vertex into exactly one octant (see subdivide()).  So either i lies on a
+// split plane or outside its child box on its way down the flat tree, or
+// its flat leaf has another vertex on its boundary, which the recursive
+// build counts in that box too and splits it further, into smaller leaves
+//
+static bool splitPlaneVertex(const Octree& octree, int i) {
+	const vector<glm::vec3>& verts = octree.mesh.getVertices();
+	Vector3 v(verts[i].x, verts[i].y, verts[i].z);
+	int n = 0;
+	while (!octree.nodes[n].isLeaf()) {
+		const FlatNode& node = octree.nodes[n];
+		Vector3 center = node.box.center();
+		if (v.x() == center.x() || v.y() == center.y() || v.z() == center.z()) return true;
+		int o = Octree::octant(v, center);
+		if (!(node.childMask & (1 << o))) return false;
+		n = node.firstChild + FlatNode::bitCount(node.childMask & ((1 << o) - 1));
+		if (!octree.nodes[n].box.inside(v)) return true;
+	}
+
+	const Box& leaf = octree.nodes[n].box;
+	for (int k = 0; k < verts.size(); k++) {
+		if (k != i && leaf.inside(Vector3(verts[k].x, verts[k].y, verts[k].z))) return true;
+	}
+	return false;
+}
+
+void benchmarkOctree(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+	vector<vector<int>> recursivePoints(numQueries);
+
+	for (int flat = 0; flat < 2; flat++) {
+		Octree octree;
+		octree.bFlatLayout = flat;
+
+		auto start = chrono::steady_clock::now();
+		octree.create(mesh, numLevels);
+		double buildMs = elapsedMicros(start) / 1000.0;
+
+		vector<Box> boxList;
+		vector<int> pointList;
+		QueryContext ctx;
+		const TreeNode* nodeRtn;
+		int indexRtn;
+
+		start = chrono::steady_clock::now();
+		for (const Ray& ray : rays) {
+			if (flat) octree.intersect(ray, 0, indexRtn);
+			else octree.intersect(ray, octree.root, nodeRtn);
+		}
+		double rayUs = elapsedMicros(start) / numQueries;
+
+		start = chrono::steady_clock::now();
+		for (const Box& box : boxes) {
+			if (flat) octree.intersect(box, ctx);
+			else {
+				boxList.clear();
+				pointList.clear();
+				octree.intersect(box, octree.root, boxList, pointList);
+			}
+		}
+		double boxUs = elapsedMicros(start) / numQueries;
+
+		// the points each box query returns, sorted, to compare the layouts
+		int differ = 0, onPlane = 0;
+		for (int i = 0; i < numQueries; i++) {
+			vector<int> points;
+			if (flat) {
+				octree.intersect(boxes[i], ctx);
+				points = ctx.points;
+			}
+			else {
+				boxList.clear();
+				octree.intersect(boxes[i], octree.root, boxList, points);
+			}
+			sort(points.begin(), points.end());
+			points.erase(unique(points.begin(), points.end()), points.end());
+			if (!flat) {
+				recursivePoints[i].swap(points);
+				continue;
+			}
+
+			// every difference must be a split plane vertex
+			vector<int> diff;
+			set_symmetric_difference(points.begin(), points.end(),
+				recursivePoints[i].begin(), recursivePoints[i].end(), back_inserter(diff));
+			for (int p : diff) {
+				if (splitPlaneVertex(octree, p)) onPlane++;
+				else differ++;
+			}
+		}
+
+		cout << name << (flat ? "  flat      " : "  recursive ")
+			<< "build " << buildMs << " ms  "
+			<< "mem " << octree.memoryUsage() / 1024 << " KB  "
+			<< "ray " << rayUs << " us  "
+			<< "box " << boxUs << " us" << endl;
+
+		if (flat) {
+			cout << name << "  box results vs recursive: " << onPlane << " split plane vertices differ (expected), "
+				<< differ << " other" << (check(differ == 0) ? "  PASS" : "  FAIL") << endl;
+
+			// closest hit query with triangle tests
+			RayHit hit;
+			int visited = 0;
+			start = chrono::steady_clock::now();
+			for (const Ray& ray : rays) {
+				octree.intersect(ray, hit);
+				visited += hit.visited;
+			}
+			cout << name << "  closest hit ray " << elapsedMicros(start) / numQueries << " us  "
+				<< "visited " << visited / (float)numQueries << " nodes" << endl;
+		}
+	}
+}
+
+static bool sameTree(const Octree& a, const Octree& b) {
+	if (a.nodes.size() != b.nodes.size() || a.pointIndex != b.pointIndex) return false;
+	for (int i = 0; i < a.nodes.size(); i++) {
+		const FlatNode& x = a.nodes[i];
+		const FlatNode& y = b.nodes[i];
+		if (x.firstChild != y.firstChild || x.begin != y.begin || x.end != y.end ||
+			x.childMask != y.childMask || x.box.parameters[0] != y.box.parameters[0] ||
+			x.box.parameters[1] != y.box.parameters[1]) return false;
+	}
+	return true;
+}
+
+void benchmarkParallelBuild(const string& name, const ofMesh& mesh, int numLevels) {
+	Octree serial;
+	serial.bFlatLayout = true;
+	auto start = chrono::steady_clock::now();
+	serial.create(mesh, numLevels);
+	double serialMs = elapsedMicros(start) / 1000.0;
+	cout << name << "  threads 1  build " << serialMs << " ms" << endl;
+
+	for (int threads = 2; threads <= ThreadPool::hardwareThreads(); threads++) {
+		ThreadPool pool(threads - 1);	// the calling thread helps while it waits
+		Octree octree;
+		octree.bFlatLayout = true;
+		octree.pool = &pool;
+
+		start = chrono::steady_clock::now();
+		octree.create(mesh, numLevels);
+		double buildMs = elapsedMicros(start) / 1000.0;
+
+		cout << name << "  threads " << threads << "  build " << buildMs << " ms  "
+			<< "speedup " << serialMs / buildMs << "x  "
+			<< (check(sameTree(serial, octree)) ? "identical" : "DIFFERENT") << endl;
+	}
+}
+
+void benchmarkLazy(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.bLazy = true;
+	auto start = chrono::steady_clock::now();
+	octree.create(mesh, numLevels);
+	double createMs = elapsedMicros(start) / 1000.0;
+
+	int nodeRtn;
+	for (int pass = 0; pass < 2; pass++) {
+		start = chrono::steady_clock::now();
+		for (const Ray& ray : rays) {
+			octree.intersect(ray, 0, nodeRtn);
+		}
+		double rayUs = elapsedMicros(start) / numQueries;
+		cout << name << "  lazy " << (pass == 0 ? "first touch " : "cached      ")
+			<< "create " << createMs << " ms  ray " << rayUs << " us  "
+			<< "expanded " << octree.expandCount << " nodes in " << octree.expandTime / 1000.0 << " ms  "
+			<< "tree " << octree.nodes.size() << " nodes" << endl;
+	}
+}
+
+void checkQueryAllocations(const string& name, const ofMesh& mesh, int numLevels) {
+	if (!allocCounting()) {
+		cout << name << "  allocation check skipped, build with SPACELANDER_COUNT_ALLOCS" << endl;
+		return;
+	}
+
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	// same pattern as ofApp::update(): result vectors are reused every frame,
+	// the first pass only grows them to their high water mark
+	QueryContext ctx;
+	ContactManifold manifold;
+	CoherenceCache groundCache, colCache;
+	size_t allocs = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		size_t start = allocCount();
+		for (int i = 0; i < numQueries; i++) {
+			RayHit hit;
+			octree.intersect(rays[i], hit);
+			octree.intersect(rays[i], hit, groundCache);
+			octree.intersect(boxes[i], ctx);
+			octree.intersect(boxes[i], ctx, colCache);
+			octree.contacts(boxes[i], manifold);
+			octree.contacts(boxes[i], manifold, colCache);
+		}
+		allocs = allocCount() - start;
+	}
+	cout << name << "  " << allocs << " allocations in " << numQueries << " frames of octree queries  "
+		<< "box results high water " << ctx.highWater << ", grown " << ctx.grows << " times"
+		<< (check(allocs == 0) ? "  PASS" : "  FAIL") << endl;
+}
+
+// bytes the old leafNodes held: subdivide() pushed a copy of the parent, with
+// every child built so far, for each single point child
+//
+static size_t legacyLeafBytes(const TreeNode& node, int& copies) {
+	size_t bytes = 0;
+	size_t builtSoFar = sizeof(TreeNode) + node.points.size() * sizeof(int);
+	for (const TreeNode& child : node.children) {
+		builtSoFar += Octree::memoryUsage(child);
+		if (child.points.size() == 1) {
+			bytes += builtSoFar;
+			copies++;
+		}
+		else bytes += legacyLeafBytes(child, copies);
+	}
+	return bytes;
+}
+
+void reportLeafMemory(const string& name, const ofMesh& mesh, int numLevels) {
+	Octree recursive;
+	recursive.create(mesh, numLevels);
+	int copies = 0;
+	size_t legacyBytes = legacyLeafBytes(recursive.root, copies);
+
+	Octree flat;
+	flat.bFlatLayout = true;
+	flat.create(mesh, numLevels);
+
+	cout << name << "  leaf list  old: " << copies << " subtree copies, " << legacyBytes / (1024 * 1024) << " MB  "
+		<< "new: " << flat.leafNodes.size() << " leaves, " << flat.leafNodes.capacity() * sizeof(int) / 1024 << " KB" << endl;
+}
+
+void benchmarkFaces(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+
+	Octree reference;
+	reference.bFlatLayout = true;
+	reference.create(mesh, numLevels);
+	vector<RayHit> expected(numQueries);
+	for (int i = 0; i < numQueries; i++) {
+		reference.intersect(rays[i], expected[i]);
+	}
+
+	int numFaces = mesh.getNumIndices() / 3;
+	for (int levels : { 8, 10, 12, numLevels }) {
+		Octree octree;
+		octree.bFlatLayout = true;
+		octree.bUseFaces = true;
+		auto start = chrono::steady_clock::now();
+		octree.create(mesh, levels);
+		double buildMs = elapsedMicros(start) / 1000.0;
+
+		RayHit hit;
+		float maxDiff = 0;
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < numQueries; i++) {
+			octree.intersect(rays[i], hit);
+			if (hit.hit() && expected[i].hit()) maxDiff = fmax(maxDiff, fabs(hit.point.y - expected[i].point.y));
+		}
+		double rayUs = elapsedMicros(start) / numQueries;
+
+		QueryContext ctx;
+		start = chrono::steady_clock::now();
+		for (const Box& box : boxes) {
+			octree.intersect(box, ctx);
+		}
+		double boxUs = elapsedMicros(start) / numQueries;
+
+		cout << name << "  faces levels " << levels << "  build " << buildMs << " ms  "
+			<< "mem " << octree.memoryUsage() / 1024 << " KB  "
+			<< "refs/face " << octree.pointIndex.size() / (float)max(numFaces, 1) << "  "
+			<< "ray " << rayUs << " us  box " << boxUs << " us  "
+			<< "altitude diff " << maxDiff << endl;
+	}
+}
+
+void benchmarkLoose(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	Box bounds = Octree::meshBounds(mesh);
+	makeQueries(bounds, numQueries, rays, boxes);
+
+	// move every box down onto the ground below it, sunk by a quarter of its
+	// height like a lander touching down
+	Octree ground;
+	ground.bFlatLayout = true;
+	ground.create(mesh, numLevels);
+	for (int i = 0; i < numQueries; i++) {
+		RayHit hit;
+		if (!ground.intersect(rays[i], hit)) continue;
+		Vector3 size = boxes[i].max() - boxes[i].min();
+		Vector3 min(boxes[i].min().x(), hit.point.y - size.y() * 0.25, boxes[i].min().z());
+		boxes[i] = Box(min, min + size);
+	}
+
+	int numFaces = mesh.getNumIndices() / 3;
+	for (float looseness : { 0.0f, 1.0f, 1.5f, 2.0f }) {
+		Octree octree;
+		octree.bFlatLayout = true;
+		octree.bUseFaces = true;
+		octree.bLoose = looseness > 0;
+		octree.looseness = looseness;
+		auto start = chrono::steady_clock::now();
+		octree.create(mesh, numLevels);
+		double buildMs = elapsedMicros(start) / 1000.0;
+
+		QueryContext ctx;
+		int contacts = 0;
+		start = chrono::steady_clock::now();
+		for (const Box& box : boxes) {
+			octree.intersect(box, ctx);
+			contacts += ctx.points.size();
+		}
+		double boxUs = elapsedMicros(start) / numQueries;
+
+		cout << name << (octree.bLoose ? "  loose " : "  strict") << " looseness " << looseness << "  "
+			<< "build " << buildMs << " ms  mem " << octree.memoryUsage() / 1024 << " KB  "
+			<< "nodes " << octree.nodes.size() << "  refs/face " << octree.pointIndex.size() / (float)max(numFaces, 1) << "  "
+			<< "box " << boxUs << " us  contacts " << contacts / (float)numQueries << endl;
+	}
+}
+
+void checkChildBoxes(const string& name, const ofMesh& mesh, int numLevels) {
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	// rays from anywhere above the terrain in any direction, so that all
+	// sign combinations get tested
+	const int numRays = 200;
+	Box bounds = octree.nodes[0].box;
+	Vector3 min = bounds.min();
+	Vector3 max = bounds.max();
+	vector<Ray> rays;
+	for (int i = 0; i < numRays; i++) {
+		Vector3 origin(ofRandom(min.x(), max.x()), ofRandom(min.y(), max.y() + 50), ofRandom(min.z(), max.z()));
+		Vector3 dir(ofRandom(-1, 1), ofRandom(-1, 0.2), ofRandom(-1, 1));
+		rays.push_back(Ray(origin, dir));
+	}
+
+	int errors = 0;
+	long tests = 0;
+	for (const Ray& ray : rays) {
+		for (int n = 0; n < octree.nodes.size(); n++) {
+			if (octree.nodes[n].isLeaf()) continue;
+			const ChildBoxes8& boxes = octree.childBounds[octree.childBoundsIndex[n]];
+			float tEnter[8], tScalar[8];
+			int mask = boxes.intersect(ray, 0, 10000, tEnter);
+			int maskScalar = boxes.intersectScalar(ray, 0, 10000, tScalar);
+			for (int c = 0; c < boxes.count; c++) {
+				float t;
+				bool hit = octree.cullBounds(octree.nodes[n].firstChild + c).intersect(ray, 0, 10000, t);
+				bool bad = hit != ((mask >> c) & 1) || hit != ((maskScalar >> c) & 1) ||
+					(hit && (t != tEnter[c] || t != tScalar[c]));
+				if (bad) errors++;
+				tests++;
+			}
+		}
+	}
+
+	// timing over the same node sweep
+	long hits = 0, hitsSimd = 0;
+	float tEnter[8];
+	auto start = chrono::steady_clock::now();
+	for (const Ray& ray : rays) {
+		for (int n = 0; n < octree.nodes.size(); n++) {
+			if (octree.nodes[n].isLeaf()) continue;
+			int first = octree.nodes[n].firstChild;
+			for (int i = first; i < first + octree.nodes[n].numChildren(); i++) {
+				hits += octree.cullBounds(i).intersect(ray, 0, 10000, tEnter[0]);
+			}
+		}
+	}
+	double boxNs = elapsedMicros(start) * 1000.0 / tests;
+	start = chrono::steady_clock::now();
+	for (const Ray& ray : rays) {
+		for (int i = 0; i < octree.childBounds.size(); i++) {
+			hitsSimd += FlatNode::bitCount(octree.childBounds[i].intersect(ray, 0, 10000, tEnter));
+		}
+	}
+	double simdNs = elapsedMicros(start) * 1000.0 / tests;
+
+	if (hits != hitsSimd) errors++;
+
+	cout << name << "  child slab test  " << tests << " boxes  " << errors << " mismatches"
+		<< (check(errors == 0) ? "  PASS" : "  FAIL") << "  Box::intersect " << boxNs << " ns/box  "
+		<< "8 wide " << simdNs << " ns/box  " << hits << " hits" << endl;
+}
+
+void benchmarkPackets(const string& name, const ofMesh& mesh, int numLevels) {
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	Vector3 min = octree.nodes[0].box.min();
+	Vector3 max = octree.nodes[0].box.max();
+	float patch = (max.x() - min.x()) * 0.1;
+
+	for (int numRays : { 1, 16, 256, 4096 }) {
+		int numSweeps = 65536 / numRays;
+		// row by row sweeps over a square patch, like a radar scan
+		vector<Ray> rays;
+		int side = sqrt(numRays);
+		for (int s = 0; s < numSweeps; s++) {
+			float x0 = ofRandom(min.x(), max.x() - patch);
+			float z0 = ofRandom(min.z(), max.z() - patch);
+			for (int i = 0; i < numRays; i++) {
+				float x = x0 + patch * (i % side) / side;
+				float z = z0 + patch * (i / side) / side;
+				rays.push_back(Ray(Vector3(x, max.y() + 10, z), Vector3(0, -1, 0)));
+			}
+		}
+
+		vector<RayHit> single(rays.size());
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < rays.size(); i++) {
+			octree.intersect(rays[i], single[i]);
+		}
+		double singleUs = elapsedMicros(start);
+
+		vector<RayHit> packet(rays.size());
+		start = chrono::steady_clock::now();
+		for (int s = 0; s < numSweeps; s++) {
+			octree.intersect(&rays[s * numRays], numRays, &packet[s * numRays]);
+		}
+		double packetUs = elapsedMicros(start);
+
+		int mismatches = 0;
+		long visitedSingle = 0, visitedPacket = 0;
+		for (int i = 0; i < rays.size(); i++) {
+			if (single[i].hit() != packet[i].hit() || glm::length(single[i].point - packet[i].point) > 1e-4) mismatches++;
+			visitedSingle += single[i].visited;
+			visitedPacket += packet[i].visited;
+		}
+
+		cout << name << "  " << numRays << " rays  single " << rays.size() / singleUs << " Mrays/s  "
+			<< "packet " << rays.size() / packetUs << " Mrays/s  speedup " << singleUs / packetUs << "x  "
+			<< "visits/ray " << visitedSingle / (float)rays.size() << " / " << visitedPacket / (float)rays.size() << "  "
+			<< mismatches << " mismatches" << (check(mismatches == 0) ? "  PASS" : "  FAIL") << endl;
+	}
+}
+
+static bool sameResults(const vector<RayHit>& a, const vector<RayHit>& b) {
+	for (int i = 0; i < a.size(); i++) {
+		if (a[i].node != b[i].node || a[i].face != b[i].face || a[i].t != b[i].t) return false;
+	}
+	return true;
+}
+
+static bool sameResults(const vector<QueryContext>& a, const vector<QueryContext>& b) {
+	for (int i = 0; i < a.size(); i++) {
+		if (a[i].points != b[i].points) return false;
+	}
+	return true;
+}
+
+void benchmarkBatchQueries(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 65536;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	vector<RayHit> serialHits, hits;
+	vector<QueryContext> serialBoxes, boxHits;
+	double serialRayUs = 0, serialBoxUs = 0;
+	for (int threads = 1; threads <= ThreadPool::hardwareThreads(); threads++) {
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) pool.reset(new ThreadPool(threads - 1));	// the calling thread helps while it waits
+		QueryExecutor executor(octree, pool.get());
+
+		executor.intersect(boxes, boxHits);	// warm up: sizes the result lists
+		auto start = chrono::steady_clock::now();
+		executor.intersect(rays, hits);
+		double rayUs = elapsedMicros(start);
+		start = chrono::steady_clock::now();
+		executor.intersect(boxes, boxHits);
+		double boxUs = elapsedMicros(start);
+
+		if (threads == 1) {
+			serialHits = hits;
+			serialBoxes = boxHits;
+			serialRayUs = rayUs;
+			serialBoxUs = boxUs;
+		}
+		bool same = sameResults(serialHits, hits) && sameResults(serialBoxes, boxHits);
+		cout << name << "  threads " << threads << "  "
+			<< "rays " << numQueries / rayUs << " M/s (" << serialRayUs / rayUs << "x)  "
+			<< "boxes " << numQueries / boxUs << " M/s (" << serialBoxUs / boxUs << "x)  "
+			<< (check(same) ? "identical" : "DIFFERENT") << endl;
+	}
+}
+
+void benchmarkSweep(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	const int numChecked = 100;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	Box bounds = Octree::meshBounds(mesh);
+	makeQueries(bounds, numQueries, rays, boxes);
+
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	// start every box above the terrain and drop it below it in one step
+	float height = bounds.max().y() - bounds.min().y();
+	glm::vec3 motion(0, -(height + 20), 0);
+	for (Box& box : boxes) {
+		Vector3 lift(0, bounds.max().y() + 10 - box.min().y(), 0);
+		box = Box(box.min() + lift, box.max() + lift);
+	}
+
+	vector<SweepHit> hits(numQueries);
+	int numHits = 0, visited = 0;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < numQueries; i++) {
+		if (octree.sweep(boxes[i], motion, hits[i])) numHits++;
+		visited += hits[i].visited;
+	}
+	double sweepUs = elapsedMicros(start) / numQueries;
+
+	// the discrete query the sweep replaces, at the point of contact
+	vector<Box> contacts;
+	for (int i = 0; i < numQueries; i++) {
+		Vector3 d(0, motion.y * hits[i].t, 0);
+		contacts.push_back(Box(boxes[i].min() + d, boxes[i].max() + d));
+	}
+	QueryContext ctx;
+	start = chrono::steady_clock::now();
+	for (const Box& box : contacts) {
+		octree.intersect(box, ctx);
+	}
+	double boxUs = elapsedMicros(start) / numQueries;
+
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	const vector<ofIndexType>& indices = mesh.getIndices();
+	Vector3 m(motion.x, motion.y, motion.z);
+	int errors = 0;
+	for (int i = 0; i < numChecked; i++) {
+		float best = 1;
+		for (int f = 0; f < indices.size() / 3; f++) {
+			const glm::vec3& a = verts[indices[3 * f]];
+			const glm::vec3& b = verts[indices[3 * f + 1]];
+			const glm::vec3& c = verts[indices[3 * f + 2]];
+			float t;
+			if (boxes[i].sweep(m, Vector3(a.x, a.y, a.z), Vector3(b.x, b.y, b.z), Vector3(c.x, c.y, c.z), best, t)) best = t;
+		}
+		if (fabs(best - hits[i].t) > 1e-5) errors++;
+	}
+
+	cout << name << "  sweep " << sweepUs << " us  box " << boxUs << " us  "
+		<< numHits << "/" << numQueries << " hit  visited " << visited / (float)numQueries << " nodes  "
+		<< (check(errors == 0) ? "PASS" : "FAIL") << " (" << errors << "/" << numChecked << " differ from brute force)" << endl;
+}
+
+void benchmarkParts(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numFrames = 1000;
+	const int numChecked = 100;
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+
+	// descent stage, ascent stage, four legs and an engine bell
+	float s = octree.width * 0.01;
+	vector<Box> parts = {
+		Box(Vector3(-s, 0, -s), Vector3(s, s, s)),
+		Box(Vector3(-0.7 * s, s, -0.7 * s), Vector3(0.7 * s, 2 * s, 0.7 * s)),
+		Box(Vector3(-1.6 * s, -0.8 * s, -0.1 * s), Vector3(-s, 0.2 * s, 0.1 * s)),
+		Box(Vector3(s, -0.8 * s, -0.1 * s), Vector3(1.6 * s, 0.2 * s, 0.1 * s)),
+		Box(Vector3(-0.1 * s, -0.8 * s, -1.6 * s), Vector3(0.1 * s, 0.2 * s, -s)),
+		Box(Vector3(-0.1 * s, -0.8 * s, s), Vector3(0.1 * s, 0.2 * s, 1.6 * s)),
+		Box(Vector3(-0.3 * s, -0.4 * s, -0.3 * s), Vector3(0.3 * s, 0, 0.3 * s)),
+	};
+	Box scene(Vector3(-1.6 * s, -0.8 * s, -1.6 * s), Vector3(1.6 * s, 2 * s, 1.6 * s));
+
+	// random poses around the ground height, yawed and slightly tilted
+	Box bounds = octree.nodes[0].box;
+	vector<vector<OrientedBox>> frames;
+	vector<Box> sceneBoxes;
+	for (int i = 0; i < numFrames; i++) {
+		float x = ofRandom(bounds.min().x(), bounds.max().x());
+		float z = ofRandom(bounds.min().z(), bounds.max().z());
+		RayHit ground;
+		if (!octree.intersect(Ray(Vector3(x, bounds.max().y() + 10, z), Vector3(0, -1, 0)), ground)) continue;
+		glm::vec3 pos(x, ground.point.y + ofRandom(-s, 2 * s), z);
+		glm::mat4 m = glm::translate(glm::mat4(1.0), pos);
+		m = glm::rotate(m, glm::radians(ofRandom(0, 360)), glm::vec3(0, 1, 0));
+		m = glm::rotate(m, glm::radians(ofRandom(-30, 30)), glm::vec3(1, 0, 0));
+
+		vector<OrientedBox> frame;
+		for (const Box& part : parts) {
+			frame.push_back(OrientedBox(part, m));
+		}
+		frames.push_back(frame);
+		Vector3 p(pos.x, pos.y, pos.z);
+		sceneBoxes.push_back(Box(scene.min() + p, scene.max() + p));
+	}
+
+	// the game's test: enough leaf boxes inside the unrotated scene AABB
+	int aabbContacts = 0;
+	QueryContext ctx;
+	auto start = chrono::steady_clock::now();
+	for (const Box& box : sceneBoxes) {
+		octree.intersect(box, ctx);
+		if (ctx.hits >= 5) aabbContacts++;
+	}
+	double aabbUs = elapsedMicros(start) / frames.size();
+
+	QueryExecutor serial(octree);
+	vector<int> serialHits;
+	int face;
+	start = chrono::steady_clock::now();
+	for (const vector<OrientedBox>& frame : frames) {
+		serialHits.push_back(serial.overlapAny(frame, face));
+	}
+	double serialUs = elapsedMicros(start) / frames.size();
+
+	ThreadPool pool;
+	QueryExecutor parallel(octree, &pool);
+	int obbContacts = 0, mismatches = 0;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < frames.size(); i++) {
+		int hit = parallel.overlapAny(frames[i], face);
+		if (hit >= 0) obbContacts++;
+		if ((hit >= 0) != (serialHits[i] >= 0)) mismatches++;
+	}
+	double parallelUs = elapsedMicros(start) / frames.size();
+
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	const vector<ofIndexType>& indices = mesh.getIndices();
+	for (int i = 0; i < numChecked && i < frames.size(); i++) {
+		bool contact = false;
+		for (const OrientedBox& obb : frames[i]) {
+			for (int f = 0; f < indices.size() / 3 && !contact; f++) {
+				contact = obb.overlap(verts[indices[3 * f]], verts[indices[3 * f + 1]], verts[indices[3 * f + 2]]);
+			}
+		}
+		if (contact != (serialHits[i] >= 0)) mismatches++;
+	}
+
+	const double frameUs = 1000000.0 / 60;
+	cout << name << "  contacts aabb " << aabbContacts << " / parts " << obbContacts << " of " << frames.size() << "  "
+		<< "aabb " << aabbUs << " us  parts serial " << serialUs << " us  "
+		<< pool.size() + 1 << " threads " << parallelUs << " us (" << 100 * parallelUs / frameUs << "% of a 60 Hz frame)  "
+		<< (check(mismatches == 0) ? "PASS" : "FAIL") << endl;
+}
+
+void benchmarkContacts(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 1000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	makeQueries(Octree::meshBounds(mesh), numQueries, rays, boxes);
+
+	for (int levels = 6; levels <= numLevels; levels += 7) {
+		Octree octree;
+		octree.bFlatLayout = true;
+		octree.create(mesh, levels);
+
+		// lander sized boxes sunk a little into the ground under them
+		vector<Box> resting;
+		for (int i = 0; i < numQueries; i++) {
+			RayHit ground;
+			if (!octree.intersect(rays[i], ground)) continue;
+			float h = (boxes[i].max().y() - boxes[i].min().y()) / 2;
+			Vector3 d(0, ground.point.y + h * 0.8 - boxes[i].center().y(), 0);
+			resting.push_back(Box(boxes[i].min() + d, boxes[i].max() + d));
+		}
+
+		// the old test: five or more leaf boxes
+		int boxContacts = 0;
+		QueryContext ctx;
+		for (const Box& box : resting) {
+			octree.intersect(box, ctx);
+			if (ctx.hits >= 5) boxContacts++;
+		}
+
+		ContactManifold manifold;
+		int contacts = 0, numContacts = 0;
+		float up = 0;
+		auto start = chrono::steady_clock::now();
+		for (const Box& box : resting) {
+			if (octree.contacts(box, manifold)) contacts++;
+			numContacts += manifold.count;
+			up += manifold.normal().y;
+		}
+		double us = elapsedMicros(start) / resting.size();
+
+		cout << name << "  levels " << levels << "  contacts: leaf boxes >= 5 " << boxContacts
+			<< "  manifold " << contacts << " of " << resting.size() << "  "
+			<< numContacts / (float)resting.size() << " contacts/box  normal.y " << up / contacts << "  "
+			<< us << " us" << endl;
+	}
+}
+
+// a lander descending along a slow random walk over the terrain
+//
+static void makeFlight(const Box& bounds, int frames, vector<Vector3>& path) {
+	Vector3 min = bounds.min();
+	Vector3 max = bounds.max();
+	float step = (max.x() - min.x()) * 0.002;
+	Vector3 p(ofRandom(min.x(), max.x()), max.y() + 10, ofRandom(min.z(), max.z()));
+	Vector3 v(ofRandom(-1, 1), 0, ofRandom(-1, 1));
+	float drop = (max.y() - min.y() + 10) / frames;
+	for (int i = 0; i < frames; i++) {
+		path.push_back(p);
+		v = Vector3(v.x() + ofRandom(-0.2, 0.2), 0, v.z() + ofRandom(-0.2, 0.2));
+		v = v * (1 / std::max(1.0f, sqrt(v * v)));
+		p = p + v * step - Vector3(0, drop, 0);
+		if (p.x() < min.x() || p.x() > max.x()) v = Vector3(-v.x(), 0, v.z());
+		if (p.z() < min.z() || p.z() > max.z()) v = Vector3(v.x(), 0, -v.z());
+	}
+}
+
+void benchmarkCoherence(const string& name, const ofMesh& mesh, int numLevels) {
+	const int frames = 2000;
+	Box bounds = Octree::meshBounds(mesh);
+	vector<Vector3> path;
+	makeFlight(bounds, frames, path);
+	float size = (bounds.max().x() - bounds.min().x()) * 0.02;
+	Vector3 half(size, size, size);
+
+	for (int levels = 6; levels <= numLevels; levels += 7) {
+		Octree octree;
+		octree.bFlatLayout = true;
+		octree.create(mesh, levels);
+
+		// the per frame queries of ofApp::update(), from the root and coherent
+		QueryContext ctx, coherentCtx;
+		ContactManifold manifold, coherentManifold;
+		CoherenceCache groundCache, colCache;
+		int visited = 0, coherentVisited = 0, mismatches = 0;
+		double us = 0, coherentUs = 0;
+		for (const Vector3& p : path) {
+			Ray ray(p, Vector3(0, -1, 0));
+			Box box(p - half, p + half);
+			RayHit hit, coherentHit;
+
+			auto start = chrono::steady_clock::now();
+			octree.intersect(ray, hit);
+			octree.intersect(box, ctx);
+			octree.contacts(box, manifold);
+			us += elapsedMicros(start);
+
+			start = chrono::steady_clock::now();
+			octree.intersect(ray, coherentHit, groundCache);
+			octree.intersect(box, coherentCtx, colCache);
+			octree.contacts(box, coherentManifold, colCache);
+			coherentUs += elapsedMicros(start);
+
+			visited += hit.visited + ctx.visited;
+			coherentVisited += coherentHit.visited + coherentCtx.visited;
+			if (hit.hit() != coherentHit.hit() || (hit.hit() && hit.t != coherentHit.t) ||
+				ctx.points != coherentCtx.points || manifold.count != coherentManifold.count) {
+				mismatches++;
+			}
+		}
+
+		cout << name << "  levels " << levels << "  coherence: ray hit rate " << groundCache.hitRate() * 100
+			<< "%  (" << groundCache.fallbacks << " fallbacks)  box hit rate " << colCache.hitRate() * 100
+			<< "%  walk ups/frame " << (groundCache.walkUps + colCache.walkUps) / (float)frames
+			<< "  nodes/frame " << visited / (float)frames << " -> " << coherentVisited / (float)frames
+			<< "  " << us / frames << " -> " << coherentUs / frames << " us"
+			<< (check(mismatches == 0) ? "  PASS" : "  FAIL (" + to_string(mismatches) + " frames differ)") << endl;
+	}
+}
+
+void benchmarkHeightGrid(const string& name, const ofMesh& mesh, int numLevels) {
+	const int numQueries = 10000;
+	vector<Ray> rays;
+	vector<Box> boxes;
+	Box bounds = Octree::meshBounds(mesh);
+	makeQueries(bounds, numQueries, rays, boxes);
+
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+	HeightGrid grid;
+	grid.build(octree);
+	if (grid.empty()) {
+		cout << name << "  height grid skipped, the mesh has no faces" << endl;
+		return;
+	}
+
+	vector<RayHit> octreeHits(numQueries), gridHits(numQueries);
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < numQueries; i++) {
+		octree.intersect(rays[i], octreeHits[i]);
+	}
+	double octreeUs = elapsedMicros(start) / numQueries;
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < numQueries; i++) {
+		const Vector3& o = rays[i].origin;
+		grid.altitude(glm::vec3(o.x(), o.y(), o.z()), gridHits[i]);
+	}
+	double gridUs = elapsedMicros(start) / numQueries;
+
+	// the octree's vertex hits (no triangle under the ray) have no grid
+	// counterpart, compare triangle hits only
+	int compared = 0, differ = 0;
+	float maxDiff = 0;
+	for (int i = 0; i < numQueries; i++) {
+		if (octreeHits[i].hit() && octreeHits[i].face < 0) continue;
+		compared++;
+		if (octreeHits[i].hit() != gridHits[i].hit()) differ++;
+		else if (gridHits[i].hit()) maxDiff = std::max(maxDiff, fabs(octreeHits[i].point.y - gridHits[i].point.y));
+	}
+
+	// bilinear height against the exact ground
+	double error = 0;
+	int sampled = 0;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < numQueries; i++) {
+		float y;
+		if (grid.sampleHeight(rays[i].origin.x(), rays[i].origin.z(), y) && gridHits[i].hit()) {
+			error += fabs(y - gridHits[i].point.y);
+			sampled++;
+		}
+	}
+	double sampleUs = elapsedMicros(start) / numQueries;
+
+	cout << name << "  height grid " << grid.cellsX << "x" << grid.cellsZ << "  "
+		<< grid.cellFaces.size() / (float)(grid.cellsX * grid.cellsZ) << " faces/cell  "
+		<< grid.numOverhangs << " overhang cells  " << grid.memoryUsage() / 1024 << " KB  built in "
+		<< grid.buildTime << " ms" << endl;
+	cout << name << "  altitude: octree ray " << octreeUs << " us  grid " << gridUs << " us  ("
+		<< octreeUs / gridUs << "x)  bilinear " << sampleUs << " us, mean error "
+		<< (sampled ? error / sampled : 0) << "  max difference " << maxDiff
+		<< (check(differ == 0 && maxDiff < 1e-3) ? "  PASS" : "  FAIL (" + to_string(differ) + " of " + to_string(compared) + " differ)") << endl;
+}
+
+void benchmarkParticles() {
+	const int steps = 10;
+	for (int n : { 10000, 100000, 300000 }) {
+		// thrust particles with lifespans running out over the steps
+		ParticlePool pool(n);
+		vector<Particle> particles;
+		bool runOld = n <= 100000;	// erase() is quadratic, keep it short
+		for (int i = 0; i < n; i++) {
+			float x = ofRandom(-1, 1), y = ofRandom(-1, 1), z = ofRandom(-1, 1);
+			glm::vec3 dir(ofRandom(-1, 1), ofRandom(0, 1), ofRandom(-1, 1));
+			float life = ofRandom(0, steps * 2);
+			pool.emit(x, y, z, life, 0.05, dir);
+			if (runOld) particles.emplace_back(x, y, z, life, 0.05, ofVec3f(dir.x, dir.y, dir.z));
+		}
+
+		auto start = chrono::steady_clock::now();
+		for (int s = 0; s < steps; s++) {
+			pool.update();
+		}
+		double poolUs = elapsedMicros(start) / steps;
+
+		double oldUs = 0;
+		if (runOld) {
+			start = chrono::steady_clock::now();
+			for (int s = 0; s < steps; s++) {
+				auto it = particles.begin();
+				while (it != particles.end()) {
+					it->update();
+					if (it->isDead()) it = particles.erase(it);
+					else ++it;
+				}
+			}
+			oldUs = elapsedMicros(start) / steps;
+		}
+
+		// same survivors, in a different order
+		bool same = true;
+		if (runOld) {
+			double sumPool = 0, sumOld = 0;
+			for (int i = 0; i < pool.size(); i++) sumPool += pool.y[i];
+			for (const Particle& p : particles) sumOld += p.position.y;
+			same = pool.size() == (int)particles.size() && fabs(sumPool - sumOld) <= 1e-3 * (fabs(sumOld) + 1);
+		}
+
+		cout << "particles " << n << "  " << pool.size() << " alive after " << steps << " steps  pool "
+			<< poolUs << " us/step";
+		if (runOld) cout << "  vector<Particle> + erase " << oldUs << " us/step (" << oldUs / poolUs << "x)";
+		cout << (check(same) ? "  PASS" : "  FAIL") << endl;
+	}
+}
+
+void benchmarkParticleDraw() {
+	const int frames = 10;
+	ofFbo fbo;
+	fbo.allocate(512, 512, GL_RGBA);
+	cout << "particle drawing on " << (const char*)glGetString(GL_RENDERER) << endl;
+
+	for (int n : { 10000, 100000, 1000000 }) {
+		ParticlePool pool(n);
+		for (int i = 0; i < n; i++) {
+			pool.emit(ofRandom(0, 512), ofRandom(0, 512), 0, 100, 0.05, glm::vec3(0, 1, 0));
+		}
+
+		// the first frame allocates the buffer
+		ParticleRenderer renderer;
+		fbo.begin();
+		ofClear(0);
+		ofSetColor(ofColor::yellow);
+		renderer.draw(pool);
+		glFinish();
+		fbo.end();
+
+		auto start = chrono::steady_clock::now();
+		for (int f = 0; f < frames; f++) {
+			fbo.begin();
+			ofClear(0);
+			renderer.draw(pool);
+			glFinish();
+			fbo.end();
+		}
+		double batchedMs = elapsedMicros(start) / frames / 1000;
+
+		// one sphere per particle, as before - a single frame, and only while
+		// it finishes in reasonable time
+		double spheresMs = 0;
+		if (n <= 100000) {
+			start = chrono::steady_clock::now();
+			fbo.begin();
+			ofClear(0);
+			for (int i = 0; i < pool.size(); i++) {
+				ofDrawSphere(pool.position(i), 1);
+			}
+			glFinish();
+			fbo.end();
+			spheresMs = elapsedMicros(start) / 1000;
+		}
+
+		cout << "particles " << n << "  batched points " << batchedMs << " ms/frame";
+		if (spheresMs > 0) cout << "  spheres " << spheresMs << " ms/frame (" << spheresMs / batchedMs << "x)";
+		cout << endl;
+	}
+}
+
+void benchmarkParticleThreads() {
+	const int n = 300000, steps = 20, burst = 4000, grain = 256;
+	double oneUs = 0, sumOne = 0;
+	for (int threads = 1; threads <= ThreadPool::hardwareThreads(); threads++) {
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) pool.reset(new ThreadPool(threads - 1));	// the calling thread helps while it waits
+
+		ParticlePool particles(n + steps * burst);
+		Rng rng(1);
+		for (int i = 0; i < n; i++) {
+			glm::vec3 dir(rng.uniform(-1, 1), rng.uniform(0, 1), rng.uniform(-1, 1));
+			particles.emit(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(0, steps * 2), 0.05, dir);
+		}
+
+		auto start = chrono::steady_clock::now();
+		for (int s = 0; s < steps; s++) {
+			int count = burst;
+			int first = particles.claim(count);
+			forEachChunk(pool.get(), count, grain, [&](int begin, int end) {
+				Rng chunk(1, (uint64_t)s * 1024 + begin / grain);
+				for (int i = begin; i < end; i++) {
+					glm::vec3 dir(chunk.uniform(-1, 1), chunk.uniform(0, 1), chunk.uniform(-1, 1));
+					particles.set(first + i, 0, 0, 0, chunk.uniform(0, steps), 0.05, dir);
+				}
+			});
+			particles.update(pool.get());
+		}
+		double us = elapsedMicros(start) / steps;
+
+		double sum = 0;
+		for (int i = 0; i < particles.size(); i++) sum += particles.x[i] + particles.y[i] + particles.z[i];
+		if (threads == 1) {
+			oneUs = us;
+			sumOne = sum;
+		}
+
+		cout << "particle threads " << threads << "  " << particles.size() << " alive  " << us << " us/step ("
+			<< oneUs / us << "x)" << (check(sum == sumOne) ? "  PASS" : "  FAIL (different particles)") << endl;
+	}
+}
+
+void benchmarkParticleCollision(const string& name, const ofMesh& mesh, int numLevels) {
+	const int n = 50000, frames = 10;
+	Octree octree;
+	octree.bFlatLayout = true;
+	octree.create(mesh, numLevels);
+	HeightGrid grid;
+	grid.build(octree);
+	if (grid.empty()) {
+		cout << name << "  particle collision skipped, the mesh has no faces" << endl;
+		return;
+	}
+
+	Box bounds = Octree::meshBounds(mesh);
+	ParticlePool scattered(n);
+	Rng rng(1);
+	for (int i = 0; i < n; i++) {
+		glm::vec3 dir(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1));
+		scattered.emit(rng.uniform(grid.x0, grid.x0 + grid.cellsX * grid.size), rng.uniform(bounds.min().y(), bounds.max().y()),
+			rng.uniform(grid.z0, grid.z0 + grid.cellsZ * grid.size), 1000, 0.05, dir);
+	}
+
+	// first frame, from a random order
+	ParticleCollider collider;
+	collider.sortByCell = false;
+	ParticlePool particles = scattered;
+	auto start = chrono::steady_clock::now();
+	int hits = collider.collide(particles, grid);
+	double unsortedUs = elapsedMicros(start);
+
+	collider.sortByCell = true;
+	particles = scattered;
+	start = chrono::steady_clock::now();
+	collider.collide(particles, grid);
+	double sortedUs = elapsedMicros(start);
+
+	// then frames of motion, the pool staying close to cell order
+	double frameUs = 0;
+	for (int f = 0; f < frames; f++) {
+		particles.update();
+		start = chrono::steady_clock::now();
+		collider.collide(particles, grid);
+		frameUs += elapsedMicros(start) / frames;
+	}
+
+	int under = 0;
+	for (int i = 0; i < particles.size(); i++) {
+		float ground;
+		if (grid.sampleHeight(particles.x[i], particles.z[i], ground) && particles.y[i] < ground - 1e-4) under++;
+	}
+
+	// killing instead of bouncing hits the same particles
+	collider.bounce = false;
+	particles = scattered;
+	int killed = collider.collide(particles, grid);
+
+	cout << name << "  particle collision " << n << " particles, " << hits << " under the ground  unsorted "
+		<< unsortedUs / 1000 << " ms  sorted " << sortedUs / 1000 << " ms  per frame " << frameUs / 1000 << " ms"
+		<< (check(under == 0 && killed == hits && particles.size() == n - hits) ? "  PASS" : "  FAIL (" + to_string(under) + " left under the ground)") << endl;
+}
+
+void benchmarkRandom(const string& name, const ofMesh& mesh, int numLevels) {
+	const int n = 1 << 22;
+	vector<float> numbers(n), scalar(n);
+	float sum = 0;
+
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < n; i++) sum += ofRandom(-1, 1);
+	double ofRandomNs = elapsedMicros(start) * 1000 / n;
+
+	Rng rng(1);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < n; i++) sum += rng.uniform(-1, 1);
+	double uniformNs = elapsedMicros(start) * 1000 / n;
+	volatile float keep = sum;	// the loops are not optimized away
+	(void)keep;
+
+	// in chunks of an emitter's size
+	Rng bulk(1), reference(1);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < n; i += 128) bulk.fill(&numbers[i], 128, -1, 1);
+	double fillNs = elapsedMicros(start) * 1000 / n;
+	for (int i = 0; i < n; i += 128) reference.fillScalar(&scalar[i], 128, -1, 1);
+	bool sameFill = numbers == scalar;
+
+	// landing areas of two trees built with the same seed, and one with another
+	vector<Box> layouts[3];
+	for (int i = 0; i < 3; i++) {
+		Octree octree;
+		octree.seed = (i < 2) ? 42 : 43;
+		octree.create(mesh, numLevels);
+		layouts[i] = octree.landingAreas;
+	}
+	auto same = [](const vector<Box>& a, const vector<Box>& b) {
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			if (!(a[i].min() == b[i].min()) || !(a[i].max() == b[i].max())) return false;
+		}
+		return true;
+	};
+
+	cout << name << "  random numbers: ofRandom " << ofRandomNs << " ns  Rng::uniform " << uniformNs << " ns ("
+		<< ofRandomNs / uniformNs << "x)  Rng::fill " << fillNs << " ns (" << ofRandomNs / fillNs << "x)  "
+		<< layouts[0].size() << " landing areas, seed 43 " << (same(layouts[0], layouts[2]) ? "same" : "different")
+		<< (check(sameFill && same(layouts[0], layouts[1])) ? "  PASS" : "  FAIL") << endl;
+}
+
+int runBenchmarks(const vector<pair<string, ofMesh>>& terrains, int numLevels) {
+	numFailures = 0;
+	for (const auto& terrain : terrains) {
+		const string& name = terrain.first;
+		const ofMesh& mesh = terrain.second;
+		benchmarkOctree(name, mesh, numLevels);
+		benchmarkParallelBuild(name, mesh, numLevels);
+		benchmarkLazy(name, mesh, numLevels);
+		checkQueryAllocations(name, mesh, numLevels);
+		reportLeafMemory(name, mesh, numLevels);
+		benchmarkFaces(name, mesh, numLevels);
+		benchmarkLoose(name, mesh, numLevels);
+		checkChildBoxes(name, mesh, numLevels);
+		benchmarkPackets(name, mesh, numLevels);
+		benchmarkBatchQueries(name, mesh, numLevels);
+		benchmarkSweep(name, mesh, numLevels);
+		benchmarkParts(name, mesh, numLevels);
+		benchmarkContacts(name, mesh, numLevels);
+		benchmarkCoherence(name, mesh, numLevels);
+		benchmarkHeightGrid(name, mesh, numLevels);
+		benchmarkParticleCollision(name, mesh, numLevels);
+		benchmarkRandom(name, mesh, numLevels);
+	}
+	benchmarkParticles();
+	benchmarkParticleDraw();
+	benchmarkParticleThreads();
+
+	if (numFailures == 0) cout << "benchmarks: all checks passed" << endl;
+	else cout << "benchmarks: " << numFailures << " checks FAILED" << endl;
+	return numFailures;
+}
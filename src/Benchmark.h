@@ -0,0 +1,128 @@
+#pragma once
+//  Octree benchmarks - results are printed to the console.  Start the app
+//  with --benchmark to run them all; it then exits with status 1 when a
+//  check failed
+//
+
+#include "ofMain.h"
+#include "Octree.h"
+
+// every benchmark below, each terrain one after the other and then the ones
+// that do not need a mesh.  Returns the number of failed checks (printed as
+// FAIL or DIFFERENT)
+//
+int runBenchmarks(const vector<pair<string, ofMesh>>& terrains, int numLevels);
+
+// build the recursive and the flat layout from the same mesh and report
+// build time, memory and average ray/box query latency for each
+//
+void benchmarkOctree(const string& name, const ofMesh& mesh, int numLevels);
+
+// build the flat layout serially and then on 2..N threads, report the speedup
+// and check that every parallel tree is identical to the serial one
+//
+void benchmarkParallelBuild(const string& name, const ofMesh& mesh, int numLevels);
+
+// lazy flat layout: startup cost, first touch vs. cached query latency and
+// how much of the tree the queries actually expanded
+//
+void benchmarkLazy(const string& name, const ofMesh& mesh, int numLevels);
+
+// run the per frame octree queries of ofApp::update() twice over the same
+// workload and check that the second pass performs no heap allocation
+// (needs a build with SPACELANDER_COUNT_ALLOCS)
+//
+void checkQueryAllocations(const string& name, const ofMesh& mesh, int numLevels);
+
+// memory held by the leaf list: what the old leafNodes (a copy of the parent
+// subtree per single point leaf) cost vs. the flat leaf index
+//
+void reportLeafMemory(const string& name, const ofMesh& mesh, int numLevels);
+
+// vertex tree at numLevels vs. face mode trees of increasing depth: build
+// time, memory, triangle references per face, closest hit / box latency and
+// the largest altitude difference to the vertex tree
+//
+void benchmarkFaces(const string& name, const ofMesh& mesh, int numLevels);
+
+// strict vs. loose face octrees on the lander collision query of
+// ofApp::update(): lander sized boxes resting on the terrain surface
+//
+void benchmarkLoose(const string& name, const ofMesh& mesh, int numLevels);
+
+// compare the eight wide child slab test against Box::intersect() on every
+// inner node for random rays, and time both
+//
+void checkChildBoxes(const string& name, const ofMesh& mesh, int numLevels);
+
+// packet ray queries vs. the same rays cast one at a time, for sweeps of
+// 1, 16, 256 and 4096 downward rays over a patch of terrain
+//
+void benchmarkPackets(const string& name, const ofMesh& mesh, int numLevels);
+
+// batches of closest hit rays and lander boxes through QueryExecutor on 1..N
+// threads: throughput, speedup over one thread and a check that every thread
+// count returns the same results
+//
+void benchmarkBatchQueries(const string& name, const ofMesh& mesh, int numLevels);
+
+// swept lander boxes falling through the whole terrain height in one step:
+// latency next to the plain box query at the contact, and a check of the time
+// of impact against testing every triangle of the mesh
+//
+void benchmarkSweep(const string& name, const ofMesh& mesh, int numLevels);
+
+// per part oriented box collision of a lander sized model at random poses on
+// the terrain: contacts reported by the single scene AABB test vs. the part
+// boxes, cost per frame serial and on all cores, and a brute force check
+//
+void benchmarkParts(const string& name, const ofMesh& mesh, int numLevels);
+
+// boxes resting on the terrain, for trees of increasing depth: how many the
+// old "five leaf boxes" test and the contact manifold see touching, contacts
+// per box, average normal and query latency
+//
+void benchmarkContacts(const string& name, const ofMesh& mesh, int numLevels);
+
+// a lander drifting down over the terrain, for trees of increasing depth: the
+// per frame ray, box and contact queries from the root vs. through a
+// CoherenceCache - hit rates, nodes visited, latency and a check that both
+// give the same results
+//
+void benchmarkCoherence(const string& name, const ofMesh& mesh, int numLevels);
+
+// altitude of random points over the terrain through the heightfield grid vs.
+// the octree ray: grid size and build cost, latency, a check that both find
+// the same ground and the error of the bilinear height sample
+//
+void benchmarkHeightGrid(const string& name, const ofMesh& mesh, int numLevels);
+
+// ParticlePool::update() vs. the vector<Particle> update and erase() loop it
+// replaces, for 10k, 100k and 300k particles dying over a few steps
+//
+void benchmarkParticles();
+
+// draw cost of 10k, 100k and 1M particles into an offscreen buffer: the
+// batched ParticleRenderer vs. one ofDrawSphere() per particle.  Run with
+// LIBGL_ALWAYS_SOFTWARE=1 to measure Mesa's llvmpipe
+//
+void benchmarkParticleDraw();
+
+// explosion load on 1 .. all cores: bursts of new particles emitted in
+// parallel chunks, each from its own Rng stream, and a parallel update of
+// 300k particles.  Checks that every thread count ends with the same particles
+//
+void benchmarkParticleThreads();
+
+// 50k particles scattered through the terrain's volume against its
+// heightfield grid: the collision stage unsorted, sorted from a random order
+// and over a few frames of motion, and a check that no particle is left under
+// the ground
+//
+void benchmarkParticleCollision(const string& name, const ofMesh& mesh, int numLevels);
+
+// ofRandom() vs. Rng::uniform() and Rng::fill() per number, a check that the
+// SIMD fill draws the same numbers as the scalar one, and that the same seed
+// gives an octree the same landing areas
+//
+void benchmarkRandom(const string& name, const ofMesh& mesh, int numLevels);
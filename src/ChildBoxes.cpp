@@ -0,0 +1,136 @@
+//  Eight wide ray-box slab test - see ChildBoxes.h
+//
+
+#include "ChildBoxes.h"
+#include <cfloat>
+
+#if !defined(SPACELANDER_NO_SIMD) && defined(__AVX__)
+#define CHILDBOXES_AVX
+#include <immintrin.h>
+#elif !defined(SPACELANDER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHILDBOXES_SSE
+#include <emmintrin.h>
+#endif
+
+// unused lanes hold an inverted box, which no ray can hit
+//
+void ChildBoxes8::clear() {
+	for (int i = 0; i < 8; i++) {
+		minX[i] = minY[i] = minZ[i] = FLT_MAX;
+		maxX[i] = maxY[i] = maxZ[i] = -FLT_MAX;
+	}
+	count = 0;
+}
+
+void ChildBoxes8::add(const Box& box) {
+	minX[count] = box.parameters[0].x();
+	minY[count] = box.parameters[0].y();
+	minZ[count] = box.parameters[0].z();
+	maxX[count] = box.parameters[1].x();
+	maxY[count] = box.parameters[1].y();
+	maxZ[count] = box.parameters[1].z();
+	count++;
+}
+
+// Box::intersect() one lane at a time
+//
+int ChildBoxes8::intersectScalar(const Ray& r, float t0, float t1, float tEnter[8]) const {
+	const float* nearX = r.sign[0] ? maxX : minX;
+	const float* farX = r.sign[0] ? minX : maxX;
+	const float* nearY = r.sign[1] ? maxY : minY;
+	const float* farY = r.sign[1] ? minY : maxY;
+	const float* nearZ = r.sign[2] ? maxZ : minZ;
+	const float* farZ = r.sign[2] ? minZ : maxZ;
+
+	int mask = 0;
+	for (int i = 0; i < count; i++) {
+		float tmin = (nearX[i] - r.origin.x()) * r.inv_direction.x();
+		float tmax = (farX[i] - r.origin.x()) * r.inv_direction.x();
+		float tymin = (nearY[i] - r.origin.y()) * r.inv_direction.y();
+		float tymax = (farY[i] - r.origin.y()) * r.inv_direction.y();
+		if ((tmin > tymax) || (tymin > tmax)) continue;
+		if (tymin > tmin) tmin = tymin;
+		if (tymax < tmax) tmax = tymax;
+		float tzmin = (nearZ[i] - r.origin.z()) * r.inv_direction.z();
+		float tzmax = (farZ[i] - r.origin.z()) * r.inv_direction.z();
+		if ((tmin > tzmax) || (tzmin > tmax)) continue;
+		if (tzmin > tmin) tmin = tzmin;
+		if (tzmax < tmax) tmax = tzmax;
+		tEnter[i] = (tmin > t0) ? tmin : t0;
+		if ((tmin < t1) && (tmax > t0)) mask |= 1 << i;
+	}
+	return mask;
+}
+
+#if defined(CHILDBOXES_AVX)
+
+// max(a, b) / min(a, b) below are ordered like the compares in
+// Box::intersect(), so NaNs (ray on a slab plane) behave the same
+//
+int ChildBoxes8::intersect(const Ray& r, float t0, float t1, float tEnter[8]) const {
+	__m256 ox = _mm256_set1_ps(r.origin.x()), ix = _mm256_set1_ps(r.inv_direction.x());
+	__m256 oy = _mm256_set1_ps(r.origin.y()), iy = _mm256_set1_ps(r.inv_direction.y());
+	__m256 oz = _mm256_set1_ps(r.origin.z()), iz = _mm256_set1_ps(r.inv_direction.z());
+
+	__m256 tmin = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[0] ? maxX : minX), ox), ix);
+	__m256 tmax = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[0] ? minX : maxX), ox), ix);
+	__m256 tymin = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[1] ? maxY : minY), oy), iy);
+	__m256 tymax = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[1] ? minY : maxY), oy), iy);
+	__m256 miss = _mm256_or_ps(_mm256_cmp_ps(tmin, tymax, _CMP_GT_OQ), _mm256_cmp_ps(tymin, tmax, _CMP_GT_OQ));
+	tmin = _mm256_max_ps(tymin, tmin);
+	tmax = _mm256_min_ps(tymax, tmax);
+
+	__m256 tzmin = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[2] ? maxZ : minZ), oz), iz);
+	__m256 tzmax = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.sign[2] ? minZ : maxZ), oz), iz);
+	miss = _mm256_or_ps(miss, _mm256_or_ps(_mm256_cmp_ps(tmin, tzmax, _CMP_GT_OQ), _mm256_cmp_ps(tzmin, tmax, _CMP_GT_OQ)));
+	tmin = _mm256_max_ps(tzmin, tmin);
+	tmax = _mm256_min_ps(tzmax, tmax);
+
+	__m256 lo = _mm256_set1_ps(t0);
+	__m256 hit = _mm256_and_ps(_mm256_cmp_ps(tmin, _mm256_set1_ps(t1), _CMP_LT_OQ), _mm256_cmp_ps(tmax, lo, _CMP_GT_OQ));
+	_mm256_storeu_ps(tEnter, _mm256_max_ps(tmin, lo));
+	return _mm256_movemask_ps(_mm256_andnot_ps(miss, hit)) & ((1 << count) - 1);
+}
+
+#elif defined(CHILDBOXES_SSE)
+
+// four lanes of the test, starting at lane i - see the AVX version
+//
+static inline int intersect4(const ChildBoxes8& b, const Ray& r, int i, float t0, float t1, float* tEnter) {
+	__m128 ox = _mm_set1_ps(r.origin.x()), ix = _mm_set1_ps(r.inv_direction.x());
+	__m128 oy = _mm_set1_ps(r.origin.y()), iy = _mm_set1_ps(r.inv_direction.y());
+	__m128 oz = _mm_set1_ps(r.origin.z()), iz = _mm_set1_ps(r.inv_direction.z());
+
+	__m128 tmin = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[0] ? b.maxX : b.minX) + i), ox), ix);
+	__m128 tmax = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[0] ? b.minX : b.maxX) + i), ox), ix);
+	__m128 tymin = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[1] ? b.maxY : b.minY) + i), oy), iy);
+	__m128 tymax = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[1] ? b.minY : b.maxY) + i), oy), iy);
+	__m128 miss = _mm_or_ps(_mm_cmpgt_ps(tmin, tymax), _mm_cmpgt_ps(tymin, tmax));
+	tmin = _mm_max_ps(tymin, tmin);
+	tmax = _mm_min_ps(tymax, tmax);
+
+	__m128 tzmin = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[2] ? b.maxZ : b.minZ) + i), oz), iz);
+	__m128 tzmax = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps((r.sign[2] ? b.minZ : b.maxZ) + i), oz), iz);
+	miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmpgt_ps(tmin, tzmax), _mm_cmpgt_ps(tzmin, tmax)));
+	tmin = _mm_max_ps(tzmin, tmin);
+	tmax = _mm_min_ps(tzmax, tmax);
+
+	__m128 lo = _mm_set1_ps(t0);
+	__m128 hit = _mm_and_ps(_mm_cmplt_ps(tmin, _mm_set1_ps(t1)), _mm_cmpgt_ps(tmax, lo));
+	_mm_storeu_ps(tEnter + i, _mm_max_ps(tmin, lo));
+	return _mm_movemask_ps(_mm_andnot_ps(miss, hit)) << i;
+}
+
+int ChildBoxes8::intersect(const Ray& r, float t0, float t1, float tEnter[8]) const {
+	int mask = intersect4(*this, r, 0, t0, t1, tEnter);
+	if (count > 4) mask |= intersect4(*this, r, 4, t0, t1, tEnter);
+	return mask & ((1 << count) - 1);
+}
+
+#else
+
+int ChildBoxes8::intersect(const Ray& r, float t0, float t1, float tEnter[8]) const {
+	return intersectScalar(r, t0, t1, tEnter);
+}
+
+#endif
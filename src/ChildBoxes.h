@@ -0,0 +1,30 @@
+#pragma once
+//  The (up to) eight child boxes of an octree node in structure of arrays
+//  form, so that one ray can be slab tested against all of them at once.
+//
+//  intersect() uses AVX when the compiler targets it, SSE otherwise (always
+//  available on x64), and a scalar loop on other CPUs or when
+//  SPACELANDER_NO_SIMD is defined.  Every path does the same arithmetic as
+//  Box::intersect(), so the results are identical to testing the boxes one by
+//  one.  The loads are unaligned: alignas(32) is only a hint for elements of
+//  a vector, which compilers without C++17 aligned new do not honour.
+//
+
+#include "box.h"
+#include "ray.h"
+
+class alignas(32) ChildBoxes8 {
+public:
+	float minX[8], minY[8], minZ[8];
+	float maxX[8], maxY[8], maxZ[8];
+	int count = 0;
+
+	ChildBoxes8() { clear(); }
+	void clear();
+	void add(const Box& box);	// next child, in child order
+
+	// bit i of the result is set when the ray hits box i within (t0, t1);
+	// tEnter[i] is then where it enters, clamped to t0
+	int intersect(const Ray& ray, float t0, float t1, float tEnter[8]) const;
+	int intersectScalar(const Ray& ray, float t0, float t1, float tEnter[8]) const;
+};
@@ -0,0 +1,172 @@
+//  Heightfield acceleration grid - see HeightGrid.h
+//
+
+#include "HeightGrid.h"
+#include "Util.h"
+
+void HeightGrid::build(Octree& tree, float cellSize) {
+	int startTime = ofGetElapsedTimeMillis();
+	octree = &tree;
+	minY.clear();
+	maxY.clear();
+	overhang.clear();
+	cellStart.clear();
+	cellFaces.clear();
+	cornerY.clear();
+	cellsX = cellsZ = 0;
+	numOverhangs = 0;
+
+	// the fallback queries of altitude() need the linear layout
+	if (!tree.bFlatLayout) {
+		ofLogWarning("HeightGrid") << "octree is not in the linear layout (bFlatLayout), grid left empty";
+		return;
+	}
+
+	const ofMesh& mesh = tree.mesh;
+	int numFaces = mesh.getNumIndices() / 3;
+	if (numFaces == 0) return;
+
+	Box bounds = Octree::meshBounds(mesh);
+	x0 = bounds.min().x();
+	z0 = bounds.min().z();
+	float w = bounds.max().x() - x0;
+	float l = bounds.max().z() - z0;
+	size = cellSize > 0 ? cellSize : sqrt(w * l / (numFaces / 2.0f));
+	if (size <= 0) size = 1;
+	cellsX = std::min(4096, (int)(w / size) + 1);
+	cellsZ = std::min(4096, (int)(l / size) + 1);
+	size = std::max(w / cellsX, l / cellsZ) * 1.0001f;	// the far edges fall inside the last cells
+	int numCells = cellsX * cellsZ;
+
+	// the terrain's side is the sign most of the projected area has, a
+	// triangle facing the other way lies below another part of the surface
+	auto projectedArea = [&](int f) {
+		const glm::vec3& a = tree.faceVertex(f, 0);
+		const glm::vec3& b = tree.faceVertex(f, 1);
+		const glm::vec3& c = tree.faceVertex(f, 2);
+		return (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+	};
+	double total = 0;
+	for (int f = 0; f < numFaces; f++) {
+		total += projectedArea(f);
+	}
+	float side = total >= 0 ? 1 : -1;
+
+	// cells a triangle's XZ bounds cover, counted and then filled (the same
+	// two passes as the vertex adjacency).  Vertical triangles can't be hit
+	// from above and are left out
+	auto cellRange = [&](int f, int& i0, int& i1, int& k0, int& k1) {
+		glm::vec3 lo = glm::min(glm::min(tree.faceVertex(f, 0), tree.faceVertex(f, 1)), tree.faceVertex(f, 2));
+		glm::vec3 hi = glm::max(glm::max(tree.faceVertex(f, 0), tree.faceVertex(f, 1)), tree.faceVertex(f, 2));
+		i0 = std::max(0, (int)((lo.x - x0) / size));
+		i1 = std::min(cellsX - 1, (int)((hi.x - x0) / size));
+		k0 = std::max(0, (int)((lo.z - z0) / size));
+		k1 = std::min(cellsZ - 1, (int)((hi.z - z0) / size));
+		return fabs(projectedArea(f)) > 1e-12f;
+	};
+	minY.assign(numCells, FLT_MAX);
+	maxY.assign(numCells, -FLT_MAX);
+	overhang.assign(numCells, 0);
+	cellStart.assign(numCells + 1, 0);
+	int i0, i1, k0, k1;
+	for (int f = 0; f < numFaces; f++) {
+		if (!cellRange(f, i0, i1, k0, k1)) continue;
+		float lo = std::min(std::min(tree.faceVertex(f, 0).y, tree.faceVertex(f, 1).y), tree.faceVertex(f, 2).y);
+		float hi = std::max(std::max(tree.faceVertex(f, 0).y, tree.faceVertex(f, 1).y), tree.faceVertex(f, 2).y);
+		bool under = projectedArea(f) * side < 0;
+		for (int k = k0; k <= k1; k++) {
+			for (int i = i0; i <= i1; i++) {
+				int c = k * cellsX + i;
+				cellStart[c + 1]++;
+				minY[c] = std::min(minY[c], lo);
+				maxY[c] = std::max(maxY[c], hi);
+				if (under) overhang[c] = 1;
+			}
+		}
+	}
+	for (int c = 0; c < numCells; c++) {
+		cellStart[c + 1] += cellStart[c];
+		numOverhangs += overhang[c];
+	}
+	cellFaces.resize(cellStart[numCells]);
+	vector<int> next(cellStart.begin(), cellStart.end() - 1);
+	for (int f = 0; f < numFaces; f++) {
+		if (!cellRange(f, i0, i1, k0, k1)) continue;
+		for (int k = k0; k <= k1; k++) {
+			for (int i = i0; i <= i1; i++) {
+				cellFaces[next[k * cellsX + i]++] = f;
+			}
+		}
+	}
+
+	// ground height at every corner for sampleHeight(); corners over a hole
+	// in the mesh take the lowest point of the terrain
+	float top = bounds.max().y() + 1;
+	float bottom = bounds.min().y();
+	cornerY.resize((cellsX + 1) * (cellsZ + 1));
+	for (int k = 0; k <= cellsZ; k++) {
+		for (int i = 0; i <= cellsX; i++) {
+			float x = std::min(x0 + i * size, bounds.max().x());
+			float z = std::min(z0 + k * size, bounds.max().z());
+			RayHit hit;
+			cornerY[k * (cellsX + 1) + i] = altitude(glm::vec3(x, top, z), hit) ? hit.point.y : bottom;
+		}
+	}
+	buildTime = ofGetElapsedTimeMillis() - startTime;
+}
+
+int HeightGrid::cell(float x, float z) const {
+	if (empty()) return -1;
+	float fx = (x - x0) / size;
+	float fz = (z - z0) / size;
+	if (fx < 0 || fz < 0 || fx >= cellsX || fz >= cellsZ) return -1;
+	return (int)fz * cellsX + (int)fx;
+}
+
+bool HeightGrid::altitude(const glm::vec3& p, RayHit& hit) {
+	// under the ground (below the cell's lowest point) the octree ray decides
+	// too, so the caller sees the same hit or miss as without the grid
+	int c = cell(p.x, p.z);
+	if (c < 0 || overhang[c] || p.y < minY[c]) {
+		return octree->intersect(Ray(Vector3(p.x, p.y, p.z), Vector3(0, -1, 0)), hit);
+	}
+
+	hit = RayHit();
+	hit.visited = 1;
+
+	// closest triangle below p: a cell's list may also hold steep triangles
+	// that do not flag it as an overhang, and one of those can be hit first
+	const glm::vec3 down(0, -1, 0);
+	for (int j = cellStart[c]; j < cellStart[c + 1]; j++) {
+		int f = cellFaces[j];
+		float t;
+		if (rayIntersectTriangle(p, down, octree->faceVertex(f, 0), octree->faceVertex(f, 1),
+			octree->faceVertex(f, 2), t) && t < hit.t) {
+			hit.node = c;
+			hit.face = f;
+			hit.t = t;
+		}
+	}
+	if (!hit.hit()) return false;
+	hit.point = glm::vec3(p.x, p.y - hit.t, p.z);
+	return true;
+}
+
+bool HeightGrid::sampleHeight(float x, float z, float& y) const {
+	if (cell(x, z) < 0) return false;
+	float fx = (x - x0) / size;
+	float fz = (z - z0) / size;
+	int i = (int)fx;
+	int k = (int)fz;
+	float u = fx - i;
+	float v = fz - k;
+	const float* row0 = &cornerY[k * (cellsX + 1) + i];
+	const float* row1 = row0 + cellsX + 1;
+	y = (row0[0] * (1 - u) + row0[1] * u) * (1 - v) + (row1[0] * (1 - u) + row1[1] * u) * v;
+	return true;
+}
+
+size_t HeightGrid::memoryUsage() const {
+	return (minY.capacity() + maxY.capacity() + cornerY.capacity()) * sizeof(float) + overhang.capacity()
+		+ (cellStart.capacity() + cellFaces.capacity()) * sizeof(int);
+}
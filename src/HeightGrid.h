@@ -0,0 +1,53 @@
+#pragma once
+//  Heightfield acceleration grid for altitude queries.
+//
+//  The terrains are 2.5D heightmaps, so a 2D grid over the mesh's XZ extent
+//  is enough to find the ground under a point: every cell keeps its min/max
+//  height and the triangles whose XZ bounds overlap it, and an altitude query
+//  is one cell lookup plus a few vertical triangle tests instead of a 3D ray
+//  walk through the octree: the closest of the cell's triangles below the
+//  point is the ground.  Cells where the surface folds back over itself
+//  (triangles facing the other way than the terrain: overhangs, caves) hold
+//  several layers of surface, and there, as outside the grid and below a
+//  cell's lowest point, the query goes to the octree.
+//
+
+#include "Octree.h"
+
+class HeightGrid {
+public:
+	// grid over octree.mesh; cellSize 0 picks about two triangles per cell.
+	// A mesh without faces, or an octree not in the linear layout
+	// (bFlatLayout), leaves the grid empty
+	void build(Octree& octree, float cellSize = 0);
+	bool empty() const { return cellStart.empty(); }
+
+	// closest triangle straight below p, the same hit as a (0, -1, 0) ray
+	// through the octree.  hit.node is the grid cell (the octree leaf when the
+	// query fell back to the octree, which subdivides a lazy octree)
+	bool altitude(const glm::vec3& p, RayHit& hit);
+
+	// surface height at x, z interpolated bilinearly between the heights at
+	// the corners of its cell.  Smooth, but only exact at the corners.
+	// False outside the grid
+	bool sampleHeight(float x, float z, float& y) const;
+
+	int cell(float x, float z) const;	// -1 outside the grid
+	size_t memoryUsage() const;
+
+	// per cell: height range and triangles, faces of cell i are
+	// cellFaces[cellStart[i] .. cellStart[i + 1])
+	vector<float> minY, maxY;
+	vector<unsigned char> overhang;	// altitude queries in this cell go to the octree
+	vector<int> cellStart;
+	vector<int> cellFaces;
+	vector<float> cornerY;		// ground height at the (cellsX + 1) * (cellsZ + 1) corners
+
+	float x0 = 0, z0 = 0;		// XZ corner of the grid
+	float size = 1;			// cell edge length
+	int cellsX = 0, cellsZ = 0;
+	int numOverhangs = 0;		// cells flagged as overhang
+	int buildTime = 0;		// ms
+
+	Octree* octree = nullptr;
+};
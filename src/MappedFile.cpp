@@ -0,0 +1,76 @@
+//  Read only memory mapped file - see MappedFile.h
+//
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	file = f;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!ptr) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (ptr) UnmapViewOfFile(ptr);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	ptr = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	length = 0;
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// the mapping keeps the file alive
+	if (p == MAP_FAILED) return false;
+
+	ptr = (const char*)p;
+	length = st.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (ptr) munmap((void*)ptr, length);
+	ptr = nullptr;
+	length = 0;
+}
+#endif
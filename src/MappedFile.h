@@ -0,0 +1,28 @@
+#pragma once
+//  Read only memory mapped file (mmap on POSIX, file mapping on Windows)
+//
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+	MappedFile() { }
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const char* data() const { return ptr; }
+	size_t size() const { return length; }
+
+private:
+	const char* ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
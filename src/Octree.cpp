@@ -10,6 +10,10 @@
 //
 
 #include "Octree.h"
+#include "Util.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 //draw a box from a "Box" class  
 //
@@ -66,24 +70,21 @@ int Octree::getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points,
 	return count;
 }
 
-// getMeshFacesInBox:  return an array of indices to Faces in mesh that are contained 
-//                      inside the Box.  Return count of faces found;
+// getMeshFacesInBox:  return an array of indices to Faces in mesh that overlap
+//                      the Box (a face straddling several boxes is returned
+//                      for each of them).  Return count of faces found;
 //
 int Octree::getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces,
 	Box& box, vector<int>& facesRtn)
 {
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	const vector<ofIndexType>& indices = mesh.getIndices();
 	int count = 0;
 	for (int i = 0; i < faces.size(); i++) {
-		ofMeshFace face = mesh.getFace(faces[i]);
-		ofVec3f v[3];
-		v[0] = face.getVertex(0);
-		v[1] = face.getVertex(1);
-		v[2] = face.getVertex(2);
-		Vector3 p[3];
-		p[0] = Vector3(v[0].x, v[0].y, v[0].z);
-		p[1] = Vector3(v[1].x, v[1].y, v[1].z);
-		p[2] = Vector3(v[2].x, v[2].y, v[2].z);
-		if (box.inside(p, 3)) {
+		const glm::vec3& v0 = verts[indices[3 * faces[i]]];
+		const glm::vec3& v1 = verts[indices[3 * faces[i] + 1]];
+		const glm::vec3& v2 = verts[indices[3 * faces[i] + 2]];
+		if (box.overlap(Vector3(v0.x, v0.y, v0.z), Vector3(v1.x, v1.y, v1.z), Vector3(v2.x, v2.y, v2.z))) {
 			count++;
 			facesRtn.push_back(faces[i]);
 		}
@@ -123,6 +124,14 @@ void Octree::subDivideBox8(const Box& box, vector<Box>& boxList) {
 	}
 }
 
+// octant:  index of the child box (in subDivideBox8() order) that holds point p
+//
+int Octree::octant(const Vector3& p, const Vector3& center) {
+	static const int floor[4] = { 0, 1, 3, 2 };
+	int i = floor[(p.x() > center.x()) | ((p.z() > center.z()) << 1)];
+	return (p.y() > center.y()) ? i + 4 : i;
+}
+
 void Octree::create(const ofMesh& geo, int numLevels) {
 	// Start measuring the time for tree creation
 	int startTime = ofGetElapsedTimeMillis();
@@ -130,15 +139,50 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 	// initialize octree structure
 	//
 	mesh = geo;
+	generation++;
 	int level = 0;
 	root.box = meshBounds(mesh);
-	if (!bUseFaces) {
+	int numFaces = mesh.getNumIndices() / 3;
+	if (bUseFaces && bLazy) {
+		ofLogWarning("Octree") << "lazy face mode trees are not supported (bLazy with bUseFaces), building it eagerly";
+		bLazy = false;
+	}
+	if (bFlatLayout && bUseFaces) {
+		// strict: face slices are copied out by subdivideFaces(), leaves first.
+		// loose: every face once, partitioned in place like the points
+		pointIndex.clear();
+		if (bLoose) {
+			for (int i = 0; i < numFaces; i++) {
+				pointIndex.push_back(i);
+			}
+		}
+		nodes.clear();
+		nodes.push_back(FlatNode());
+		nodes[0].box = root.box;
+		nodes[0].end = pointIndex.size();
+		nodes[0].level = 1;
+	}
+	else if (bFlatLayout) {
+		// one shared index buffer; subdivide() only ever partitions it
+		pointIndex.resize(mesh.getNumVertices());
+		for (int i = 0; i < pointIndex.size(); i++) {
+			pointIndex[i] = i;
+		}
+		nodes.clear();
+		nodes.push_back(FlatNode());
+		nodes[0].box = root.box;
+		nodes[0].end = pointIndex.size();
+		nodes[0].level = 1;
+	}
+	else if (!bUseFaces) {
 		for (int i = 0; i < mesh.getNumVertices(); i++) {
 			root.points.push_back(i);
 		}
 	}
 	else {
-		// need to load face vertices here
+		for (int i = 0; i < numFaces; i++) {
+			root.points.push_back(i);
+		}
 	}
 
 	width = root.box.max().x() - root.box.min().x();
@@ -151,8 +195,48 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 
 	// recursively buid octree
 	level++;
-	subdivide(mesh, root, numLevels, level);
+	levels = numLevels;
+	expandCount = 0;
+	expandTime = 0;
+	uint64_t key = 0;
+	bool bUseCache = bFlatLayout && !bLazy && !cachePath.empty();
+	bLoadedFromCache = false;
+	if (bUseCache) {
+		key = cacheKey(numLevels);
+		bLoadedFromCache = load(cachePath, key);
+	}
+
+	if (bLoadedFromCache) { /* nodes and pointIndex came from the cache */ }
+	else if (bFlatLayout && bUseFaces && bLoose) subdivideLoose(mesh, 0, numLevels, level);
+	else if (bFlatLayout && bUseFaces) {
+		vector<int> faces(numFaces);
+		for (int i = 0; i < numFaces; i++) {
+			faces[i] = i;
+		}
+		subdivideFaces(mesh, 0, faces, numLevels, level);
+	}
+	else if (bFlatLayout && bLazy) { /* nodes are subdivided by the queries */ }
+	else if (bFlatLayout && pool) buildSubtree(mesh, nodes, numLevels, level);
+	else if (bFlatLayout) subdivide(mesh, nodes, 0, numLevels, level);
+	else subdivide(mesh, root, numLevels, level);
+	if (bUseCache && !bLoadedFromCache) save(cachePath, key);
+	if (bFlatLayout && (!bUseFaces || bLoose)) buildFaceBounds();
+	if (bFlatLayout) buildChildBounds();
+	leafNodes.clear();
+	if (bFlatLayout && !bLazy) {
+		for (int i = 0; i < nodes.size(); i++) {
+			if (nodes[i].isLeaf()) leafNodes.push_back(i);
+		}
+		leafNodes.shrink_to_fit();
+	}
+	numLeaf = leafNodes.size();
 	generateLandingAreas();
+
+	buildTime = ofGetElapsedTimeMillis() - startTime;
+	ofLogVerbose("Octree") << (bFlatLayout ? nodes.size() : 0) << " flat nodes, "
+		<< (pool ? pool->size() + 1 : 1) << " threads, "
+		<< memoryUsage() / 1024 << " KB, " << (bLoadedFromCache ? "loaded" : "built")
+		<< " in " << buildTime << " ms";
 }
 
 
@@ -181,33 +265,469 @@ void Octree::subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int le
 		TreeNode childNode;
 		childNode.box = childBoxes[i];
 
-		// Get points inside the child box
-		getMeshPointsInBox(mesh, node.points, childNode.box, childNode.points);
+		// Get points (faces) inside the child box
+		if (bUseFaces) getMeshFacesInBox(mesh, node.points, childNode.box, childNode.points);
+		else getMeshPointsInBox(mesh, node.points, childNode.box, childNode.points);
 
 		// If the child node contains at least 1 point, add it to the tree
 		if (!childNode.points.empty()) {
 			node.children.push_back(childNode);
 
 			// If the child node is not a leaf (contains more than 1 point), recursively subdivide
-			if (childNode.points.size() > 1) {
+			if (childNode.points.size() > (bUseFaces ? maxFacesPerLeaf : 1)) {
 				subdivide(mesh, node.children.back(), numLevels, level + 1);
 			}
-			else leafNodes.push_back(node);
 		}
 	}
 }
 
+// subdivide (linear layout):  same algorithm as above, but instead of copying
+//  point indices into every child, the node's slice of pointIndex is partitioned
+//  in place into its eight octants (bucket sort style).  Each child then refers
+//  to a sub-slice of its parent, so the whole tree shares one index array.
+//  A point lying exactly on a split plane belongs to the lower octant only,
+//  where the recursive layout copies it into every child box it touches;
+//  benchmarkOctree() checks that the box queries differ by no more than that.
+//
+void Octree::subdivide(const ofMesh& mesh, vector<FlatNode>& tree, int n, int numLevels, int level) {
+	if (level >= numLevels) {
+		return;
+	}
+
+	int first = tree.size();
+	partition(mesh, tree, n);
+
+	// recurse into children that are not leaves (contain more than 1 point)
+	int last = tree.size();
+	for (int i = first; i < last; i++) {
+		if (tree[i].numPoints() > 1) {
+			subdivide(mesh, tree, i, numLevels, level + 1);
+		}
+	}
+}
+
+//  partition:  sort the node's slice of pointIndex into octants and append the
+//              non empty octants to the tree as one block of children
+//
+void Octree::partition(const ofMesh& mesh, vector<FlatNode>& tree, int n) {
+	// tree may reallocate below, so copy what we need out of the node
+	Box box = tree[n].box;
+	int begin = tree[n].begin;
+	int end = tree[n].end;
+	Vector3 center = box.center();
+	const vector<glm::vec3>& verts = mesh.getVertices();
+
+	// count the points falling into each octant
+	int count[8] = { 0 };
+	for (int i = begin; i < end; i++) {
+		const glm::vec3& v = verts[pointIndex[i]];
+		count[octant(Vector3(v.x, v.y, v.z), center)]++;
+	}
+
+	// bucket start offsets, then swap every point into its bucket
+	int start[8], next[8];
+	start[0] = begin;
+	for (int i = 1; i < 8; i++) {
+		start[i] = start[i - 1] + count[i - 1];
+	}
+	for (int i = 0; i < 8; i++) {
+		next[i] = start[i];
+	}
+	for (int i = 0; i < 8; i++) {
+		while (next[i] < start[i] + count[i]) {
+			const glm::vec3& v = verts[pointIndex[next[i]]];
+			int o = octant(Vector3(v.x, v.y, v.z), center);
+			if (o == i) next[i]++;
+			else swap(pointIndex[next[i]], pointIndex[next[o]++]);
+		}
+	}
+
+	vector<Box> childBoxes;
+	subDivideBox8(box, childBoxes);
+
+	int first = tree.size();
+	unsigned char mask = 0;
+	for (int i = 0; i < 8; i++) {
+		if (count[i] > 0) {
+			FlatNode child;
+			child.box = childBoxes[i];
+			child.begin = start[i];
+			child.end = start[i] + count[i];
+			child.level = tree[n].level + 1;
+			tree.push_back(child);
+			mask |= 1 << i;
+		}
+	}
+	tree[n].firstChild = first;
+	tree[n].childMask = mask;
+}
+
+//  subdivideFaces:  face mode build.  Unlike points, a triangle can overlap
+//  several child boxes, so the triangles of a node are handed down as lists
+//  (a triangle goes into every child it overlaps) instead of partitioning a
+//  shared slice.  Leaves append their list to pointIndex in depth first order,
+//  which leaves every node's [begin, end) covering the references of its whole
+//  subtree, duplicates included.
+//
+void Octree::subdivideFaces(const ofMesh& mesh, int n, vector<int>& faces, int numLevels, int level) {
+	nodes[n].begin = pointIndex.size();
+	if (level >= numLevels || faces.size() <= maxFacesPerLeaf) {
+		pointIndex.insert(pointIndex.end(), faces.begin(), faces.end());
+		nodes[n].end = pointIndex.size();
+		return;
+	}
+
+	vector<Box> childBoxes;
+	subDivideBox8(nodes[n].box, childBoxes);
+
+	vector<int> childFaces[8];
+	int first = nodes.size();
+	unsigned char mask = 0;
+	for (int i = 0; i < 8; i++) {
+		getMeshFacesInBox(mesh, faces, childBoxes[i], childFaces[i]);
+		if (!childFaces[i].empty()) {
+			FlatNode child;
+			child.box = childBoxes[i];
+			child.level = nodes[n].level + 1;
+			nodes.push_back(child);
+			mask |= 1 << i;
+		}
+	}
+	nodes[n].firstChild = first;
+	nodes[n].childMask = mask;
+
+	// the children hold copies now - free this level before going deeper
+	vector<int>().swap(faces);
+
+	int child = first;
+	for (int i = 0; i < 8; i++) {
+		if (!childFaces[i].empty()) {
+			subdivideFaces(mesh, child++, childFaces[i], numLevels, level + 1);
+		}
+	}
+	nodes[n].end = pointIndex.size();
+}
+
+//  subdivideLoose:  loose octree build.  Works like the point subdivide(): the
+//  node's slice of pointIndex is partitioned in place, only the triangles too
+//  big for any loose child cell stay at the front of the slice, owned by the
+//  node itself.  No triangle is ever copied, so pointIndex holds exactly one
+//  entry per face.
+//
+void Octree::subdivideLoose(const ofMesh& mesh, int n, int numLevels, int level) {
+	if (level >= numLevels || nodes[n].numPoints() <= maxFacesPerLeaf) {
+		return;
+	}
+
+	int first = nodes.size();
+	partitionLoose(mesh, n);
+
+	int last = nodes.size();
+	for (int i = first; i < last; i++) {
+		subdivideLoose(mesh, i, numLevels, level + 1);
+	}
+}
+
+//  partitionLoose:  sort the node's faces into the ones staying at the node
+//                   (first) and the ones fitting a loose child cell, then
+//                   append the non empty octants as one block of children
+//
+void Octree::partitionLoose(const ofMesh& mesh, int n) {
+	Box box = nodes[n].box;
+	int begin = nodes[n].begin;
+	int end = nodes[n].end;
+	Vector3 center = box.center();
+
+	vector<Box> childBoxes;
+	subDivideBox8(box, childBoxes);
+	Vector3 grow = (childBoxes[0].max() - childBoxes[0].min()) * ((looseness - 1) / 2);
+	Box looseCells[8];
+	for (int i = 0; i < 8; i++) {
+		looseCells[i] = Box(childBoxes[i].min() - grow, childBoxes[i].max() + grow);
+	}
+
+	// bucket 0 stays at the node, bucket o + 1 goes to octant o
+	int count[9] = { 0 };
+	for (int i = begin; i < end; i++) {
+		count[looseOctant(pointIndex[i], center, looseCells) + 1]++;
+	}
+
+	int start[9], next[9];
+	start[0] = begin;
+	for (int i = 1; i < 9; i++) {
+		start[i] = start[i - 1] + count[i - 1];
+	}
+	for (int i = 0; i < 9; i++) {
+		next[i] = start[i];
+	}
+	for (int i = 0; i < 9; i++) {
+		while (next[i] < start[i] + count[i]) {
+			int b = looseOctant(pointIndex[next[i]], center, looseCells) + 1;
+			if (b == i) next[i]++;
+			else swap(pointIndex[next[i]], pointIndex[next[b]++]);
+		}
+	}
+
+	int first = nodes.size();
+	unsigned char mask = 0;
+	for (int i = 0; i < 8; i++) {
+		if (count[i + 1] > 0) {
+			FlatNode child;
+			child.box = childBoxes[i];
+			child.begin = start[i + 1];
+			child.end = start[i + 1] + count[i + 1];
+			child.level = nodes[n].level + 1;
+			nodes.push_back(child);
+			mask |= 1 << i;
+		}
+	}
+	if (mask) {
+		nodes[n].firstChild = first;
+		nodes[n].childMask = mask;
+	}
+}
+
+//  looseOctant:  octant of the triangle's centroid when the triangle fits in
+//                that octant's loose cell, -1 when it has to stay at the parent
+//
+int Octree::looseOctant(int face, const Vector3& center, const Box* looseCells) const {
+	const glm::vec3& v0 = faceVertex(face, 0);
+	const glm::vec3& v1 = faceVertex(face, 1);
+	const glm::vec3& v2 = faceVertex(face, 2);
+	glm::vec3 min = glm::min(v0, glm::min(v1, v2));
+	glm::vec3 max = glm::max(v0, glm::max(v1, v2));
+	glm::vec3 c = (v0 + v1 + v2) / 3.0f;
+	int o = octant(Vector3(c.x, c.y, c.z), center);
+	if (looseCells[o].inside(Vector3(min.x, min.y, min.z)) && looseCells[o].inside(Vector3(max.x, max.y, max.z))) {
+		return o;
+	}
+	return -1;
+}
+
+//  expand:  lazy mode - subdivide a node one level the first time a query
+//           reaches it.  The children stay in nodes for later frames.
+//
+void Octree::expand(int n) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	int first = nodes.size();
+	partition(mesh, nodes, n);
+	if (!faceBounds.empty()) {
+		for (int i = first; i < nodes.size(); i++) {
+			faceBounds.push_back(fanBounds(nodes[i].begin, nodes[i].end));
+		}
+	}
+	childBoundsIndex.resize(nodes.size(), -1);
+	addChildBounds(n);
+	expandCount++;
+	expandTime += ofGetElapsedTimeMicros() - start;
+}
+
+//  expandAll:  lazy mode - subdivide every node no query has reached yet.
+//              The tree is then complete and stops being lazy, and the const
+//              queries may run on it from any number of threads.
+//
+void Octree::expandAll() {
+	if (!bLazy) return;
+
+	// children are appended behind their parent, so one pass reaches them all
+	for (int n = 0; n < nodes.size(); n++) {
+		if (isUnexpanded(n)) expand(n);
+	}
+	bLazy = false;
+
+	leafNodes.clear();
+	for (int i = 0; i < nodes.size(); i++) {
+		if (nodes[i].isLeaf()) leafNodes.push_back(i);
+	}
+	leafNodes.shrink_to_fit();
+	numLeaf = leafNodes.size();
+}
+
+//  expandRegion:  lazy mode - subdivide node n and every node below it whose
+//                 cell or cullBounds() touch region: all the nodes a box
+//                 query, contact or overlap test of region can reach.
+//
+void Octree::expandRegion(const Box& region, int n) {
+	if (!bLazy) return;
+	if (isUnexpanded(n)) expand(n);
+
+	// expand() appends to nodes, so only hold indices
+	int first = nodes[n].firstChild;
+	int last = first + nodes[n].numChildren();
+	for (int c = first; c < last; c++) {
+		if (nodes[c].box.overlap(region) || cullBounds(c).overlap(region)) expandRegion(region, c);
+	}
+}
+
+//  expandAlong:  lazy mode - the same for the nodes a ray query up to tMax
+//                can reach.
+//
+void Octree::expandAlong(const Ray& ray, float tMax, int n) {
+	if (!bLazy) return;
+	if (isUnexpanded(n)) expand(n);
+
+	int first = nodes[n].firstChild;
+	int last = first + nodes[n].numChildren();
+	for (int c = first; c < last; c++) {
+		if (nodes[c].box.intersect(ray, 0, tMax) || cullBounds(c).intersect(ray, 0, tMax)) expandAlong(ray, tMax, c);
+	}
+}
+
+// bounds of the ray from t = 0 to t
+//
+static Box segmentBounds(const Ray& ray, float t) {
+	Vector3 end = ray.origin + ray.direction * t;
+	return Box(Vector3(std::min(ray.origin.x(), end.x()), std::min(ray.origin.y(), end.y()), std::min(ray.origin.z(), end.z())),
+		Vector3(std::max(ray.origin.x(), end.x()), std::max(ray.origin.y(), end.y()), std::max(ray.origin.z(), end.z())));
+}
+
+// the region a box moving by motion passes through
+//
+static Box sweptBounds(const Box& box, const glm::vec3& motion) {
+	Vector3 m(motion.x, motion.y, motion.z);
+	Vector3 lo = box.min(), hi = box.max();
+	return Box(Vector3(std::min(lo.x(), lo.x() + m.x()), std::min(lo.y(), lo.y() + m.y()), std::min(lo.z(), lo.z() + m.z())),
+		Vector3(std::max(hi.x(), hi.x() + m.x()), std::max(hi.y(), hi.y() + m.y()), std::max(hi.z(), hi.z() + m.z())));
+}
+
+// lazy mode entry points: expand what the query can reach, then run the const
+// query
+//
+bool Octree::intersect(const Ray& ray, int n, int& nodeRtn) {
+	expandAlong(ray, 10000.0, n);
+	return static_cast<const Octree&>(*this).intersect(ray, n, nodeRtn);
+}
+
+bool Octree::intersect(const Ray& ray, RayHit& hit, float tMax) {
+	expandAlong(ray, tMax);
+	return static_cast<const Octree&>(*this).intersect(ray, hit, tMax);
+}
+
+bool Octree::intersect(const Ray& ray, RayHit& hit, CoherenceCache& cache, float tMax) {
+	// startNode() descends by the bounds of the probed segment
+	if (bLazy && cache.lastT >= 0) expandRegion(segmentBounds(ray, probeLength(cache, tMax)));
+	expandAlong(ray, tMax);
+	return static_cast<const Octree&>(*this).intersect(ray, hit, cache, tMax);
+}
+
+int Octree::intersect(const Ray* rays, int numRays, RayHit* hits, float tMax) {
+	for (int i = 0; i < numRays && bLazy; i++) expandAlong(rays[i], tMax);
+	return static_cast<const Octree&>(*this).intersect(rays, numRays, hits, tMax);
+}
+
+bool Octree::intersect(const Box& box, QueryContext& ctx) {
+	expandRegion(box);
+	return static_cast<const Octree&>(*this).intersect(box, ctx);
+}
+
+bool Octree::intersect(const Box& box, QueryContext& ctx, CoherenceCache& cache) {
+	expandRegion(box);
+	return static_cast<const Octree&>(*this).intersect(box, ctx, cache);
+}
+
+bool Octree::sweep(const Box& box, const glm::vec3& motion, SweepHit& hit) {
+	if (bLazy) expandRegion(sweptBounds(box, motion));
+	return static_cast<const Octree&>(*this).sweep(box, motion, hit);
+}
+
+bool Octree::overlap(const OrientedBox& obb, int& faceRtn, const std::atomic<bool>* stop) {
+	if (bLazy) expandRegion(obb.bounds());
+	return static_cast<const Octree&>(*this).overlap(obb, faceRtn, stop);
+}
+
+int Octree::contacts(const Box& box, ContactManifold& manifold) {
+	expandRegion(box);
+	return static_cast<const Octree&>(*this).contacts(box, manifold);
+}
+
+int Octree::contacts(const Box& box, ContactManifold& manifold, CoherenceCache& cache) {
+	expandRegion(box);
+	return static_cast<const Octree&>(*this).contacts(box, manifold, cache);
+}
+
+//  buildSubtree:  parallel version of subdivide() for the node tree[0].
+//
+//  Down to parallelLevels, every child is built as its own task into its own
+//  node array and the finished subtrees are spliced back in child order.  The
+//  children of a node are always followed by the complete subtree of the first
+//  child, then the second, ... exactly as subdivide() lays them out, so the
+//  result is bit-identical to the serial build.  Point slices of siblings never
+//  overlap, so the tasks can partition pointIndex concurrently.
+//
+void Octree::buildSubtree(const ofMesh& mesh, vector<FlatNode>& tree, int numLevels, int level) {
+	if (level >= numLevels || level > parallelLevels || tree[0].numPoints() < parallelGrain) {
+		subdivide(mesh, tree, 0, numLevels, level);
+		return;
+	}
+
+	partition(mesh, tree, 0);
+
+	int numChildren = tree[0].numChildren();
+	vector<vector<FlatNode>> subtrees(numChildren);
+	TaskGroup group;
+	for (int i = 0; i < numChildren; i++) {
+		if (tree[1 + i].numPoints() > 1) {
+			subtrees[i].push_back(tree[1 + i]);
+			pool->run(group, [this, &mesh, &subtrees, i, numLevels, level] {
+				buildSubtree(mesh, subtrees[i], numLevels, level + 1);
+			});
+		}
+	}
+	pool->wait(group);
+
+	for (int i = 0; i < numChildren; i++) {
+		if (!subtrees[i].empty()) splice(tree, 1 + i, subtrees[i]);
+	}
+}
+
+//  splice:  replace leaf tree[n] by a subtree built on its own (subtree[0] is
+//           the node itself) appending the subtree's nodes to the tree
+//
+void Octree::splice(vector<FlatNode>& tree, int n, const vector<FlatNode>& subtree) {
+	int offset = tree.size() - 1;
+	tree[n] = subtree[0];
+	if (!tree[n].isLeaf()) tree[n].firstChild += offset;
+	for (int i = 1; i < subtree.size(); i++) {
+		tree.push_back(subtree[i]);
+		if (!tree.back().isLeaf()) tree.back().firstChild += offset;
+	}
+}
+
 // generate new set of landing areas
 void Octree::generateLandingAreas() {
 	landingAreas.clear();
 	landingPoints.clear();
+	Rng rng(seed, rngStream(RngLanding, landingStream));
 
 	// randomly pick leaf node to create landing area from
-	for (TreeNode leaf : leafNodes) {
-		if (ofRandom(1) < 0.1 && nLandings < maxLandings) {
-			glm::vec3 point = mesh.getVertex(leaf.points[0]);
-			createLanding(point);
+	if (bFlatLayout && bLazy) {
+		// leaves do not exist yet - any vertex stands in for a single point leaf
+		for (int i = 0; i < mesh.getNumVertices() && nLandings < maxLandings; i++) {
+			if (rng.uniform() < 0.1) createLanding(mesh.getVertex(i));
 		}
+		return;
+	}
+	if (bFlatLayout) {
+		for (int leaf : leafNodes) {
+			if (rng.uniform() < 0.1 && nLandings < maxLandings) {
+				createLanding(leafPoint(leaf));
+			}
+		}
+		return;
+	}
+	generateLandingAreas(root, rng);
+}
+
+// recursive layout: visit the leaves in depth first order
+void Octree::generateLandingAreas(const TreeNode& node, Rng& rng) {
+	if (node.children.empty()) {
+		if (rng.uniform() < 0.1 && nLandings < maxLandings) {
+			createLanding(mesh.getVertex(node.points[0]));
+		}
+		return;
+	}
+	for (const TreeNode& child : node.children) {
+		generateLandingAreas(child, rng);
 	}
 }
 
@@ -226,7 +746,7 @@ void Octree::createLanding(glm::vec3 point) {
 
 	// check 1: new landing doesn't overlap with other areas
 	bool hit = false;
-	for (Box landing : landingAreas) {
+	for (const Box& landing : landingAreas) {
 		if (landing.overlap(b)) {
 			hit = true;
 			break;
@@ -271,11 +791,11 @@ void Octree::createLanding(glm::vec3 point) {
 }
 
 // octree intersect with ray
-bool Octree::intersect(const Ray& ray, const TreeNode& node, TreeNode& nodeRtn) {
+bool Octree::intersect(const Ray& ray, const TreeNode& node, const TreeNode*& nodeRtn) {
 	bool intersects = false;
 
 	if (node.points.size() == 1 || node.children.empty()) {
-		nodeRtn = node;
+		nodeRtn = &node;
 		return true;
 	}
 
@@ -330,4 +850,831 @@ void Octree::draw(TreeNode& node, int numLevels, int level) {
 	for (int i = 0; i < node.children.size(); i++) {
 		draw(node.children[i], numLevels, level + 1);
 	}
-}
\ No newline at end of file
+}
+
+// octree intersect with ray (linear layout)
+bool Octree::intersect(const Ray& ray, int n, int& nodeRtn) const {
+	bool intersects = false;
+
+	assertExpanded(n);
+	if (nodes[n].isLeaf()) {
+		nodeRtn = n;
+		return true;
+	}
+
+	if (nodes[n].box.intersect(ray, 0, 10000.0)) {
+		int first = nodes[n].firstChild;
+		int last = first + nodes[n].numChildren();
+		for (int i = first; i < last; i++) {
+			if (nodes[i].box.intersect(ray, 0, 10000.0)) {
+				intersects = intersect(ray, i, nodeRtn);
+			}
+		}
+	}
+
+	return intersects;
+}
+
+//  intersect:  closest hit along the ray within [0, tMax).
+//
+//  Children are visited front to back by the distance at which the ray enters
+//  them, and a subtree is skipped once a hit closer than its entry distance is
+//  known.  In a leaf the triangles around its vertices are tested, giving the
+//  exact hit distance and point.  Nodes are culled by faceBounds, which also
+//  covers the parts of those triangles sticking out of the node, so no
+//  triangle the ray crosses is ever missed.  When the mesh has no faces the
+//  first leaf along the ray is reported as a vertex hit (the old behavior).
+//
+bool Octree::intersect(const Ray& ray, RayHit& hit, float tMax) const {
+	hit = RayHit();
+	hit.t = tMax;
+	RayHit firstLeaf;
+	firstLeaf.t = tMax;
+
+	float tEnter;
+	if (cullBounds(0).intersect(ray, 0, tMax, tEnter)) {
+		intersect(ray, 0, tEnter, hit, firstLeaf);
+	}
+	vertexHit(ray, hit, firstLeaf);
+	return hit.hit();
+}
+
+// coherent closest hit: search only the segment up to a little past last
+// frame's hit, starting below the root.  A hit there is the closest one;
+// otherwise (the ground dropped away, or a vertex hit would be needed) the
+// query is repeated from the root
+//
+bool Octree::intersect(const Ray& ray, RayHit& hit, CoherenceCache& cache, float tMax) const {
+	if (cache.lastT >= 0 && hasFaces()) {
+		float tProbe = probeLength(cache, tMax);
+		int n = startNode(segmentBounds(ray, tProbe), cache);
+
+		hit = RayHit();
+		hit.t = tProbe;
+		RayHit firstLeaf;
+		firstLeaf.t = tProbe;
+		float tEnter;
+		if (cullBounds(n).intersect(ray, 0, tProbe, tEnter)) {
+			intersect(ray, n, tEnter, hit, firstLeaf);
+		}
+		if (hit.hit()) {
+			cache.lastT = hit.t;
+			return true;
+		}
+		cache.fallbacks++;
+	}
+	intersect(ray, hit, tMax);
+	cache.lastT = hit.hit() ? hit.t : -1;
+	return hit.hit();
+}
+
+// the mesh has no faces: report the first leaf along the ray.  A ray that
+// misses every triangle of a mesh with faces misses the terrain
+//
+void Octree::vertexHit(const Ray& ray, RayHit& hit, RayHit& firstLeaf) const {
+	if (!hit.hit() && firstLeaf.hit() && !hasFaces()) {
+		glm::vec3 origin(ray.origin.x(), ray.origin.y(), ray.origin.z());
+		glm::vec3 dir(ray.direction.x(), ray.direction.y(), ray.direction.z());
+		firstLeaf.t = glm::dot(firstLeaf.point - origin, dir) / glm::dot(dir, dir);
+		firstLeaf.visited = hit.visited;
+		hit = firstLeaf;
+	}
+}
+
+int Octree::intersect(const Ray* rays, int numRays, RayHit* hits, float tMax) const {
+	for (int i = 0; i < numRays; i += rayPacketSize) {
+		int count = numRays - i;
+		if (count > rayPacketSize) count = rayPacketSize;
+		intersectPacket(rays + i, count, hits + i, tMax);
+	}
+	int numHits = 0;
+	for (int i = 0; i < numRays; i++) {
+		if (hits[i].hit()) numHits++;
+	}
+	return numHits;
+}
+
+void Octree::intersectPacket(const Ray* rays, int count, RayHit* hits, float tMax) const {
+	RayHit firstLeaf[rayPacketSize];
+	float tEnter[rayPacketSize];
+	uint32_t active = 0;
+	for (int i = 0; i < count; i++) {
+		hits[i] = RayHit();
+		hits[i].t = tMax;
+		firstLeaf[i].t = tMax;
+		if (cullBounds(0).intersect(rays[i], 0, tMax, tEnter[i])) active |= 1u << i;
+	}
+	if (active) intersect(rays, 0, active, tEnter, hits, firstLeaf);
+	for (int i = 0; i < count; i++) {
+		vertexHit(rays[i], hits[i], firstLeaf[i]);
+	}
+}
+
+// index of the lowest set bit of m (m != 0)
+//
+static inline int lowestBit(uint32_t m) {
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, m);
+	return i;
+#else
+	return __builtin_ctz(m);
+#endif
+}
+
+//  packet traversal:  same as the single ray version, but every node is
+//  visited once for all the active rays of the packet (bit i = rays[i]).
+//  Children are visited in order of the nearest entry of any ray, and each
+//  ray still skips a child it enters behind its own closest hit.
+//
+void Octree::intersect(const Ray* rays, int n, uint32_t active, const float* tEnter, RayHit* hits, RayHit* firstLeaf) const {
+	assertExpanded(n);
+	for (uint32_t m = active; m; m &= m - 1) {
+		int i = lowestBit(m);
+		hits[i].visited++;
+		if (nodes[n].isLeaf()) {
+			intersectLeaf(rays[i], n, hits[i]);
+			if (tEnter[i] < firstLeaf[i].t) {
+				firstLeaf[i].node = n;
+				firstLeaf[i].t = tEnter[i];
+				firstLeaf[i].point = leafPoint(n);
+			}
+		}
+		else if (ownEnd(n) > nodes[n].begin) intersectLeaf(rays[i], n, hits[i]);
+	}
+	if (nodes[n].isLeaf()) return;
+
+	// which rays enter which child, and where
+	float entry[8][rayPacketSize];
+	uint32_t childActive[8] = { 0 };
+	float nearest[8];
+	for (int c = 0; c < 8; c++) {
+		nearest[c] = FLT_MAX;
+	}
+	for (uint32_t m = active; m; m &= m - 1) {
+		int i = lowestBit(m);
+		float t[8];
+		int mask = childBounds[childBoundsIndex[n]].intersect(rays[i], 0, hits[i].t, t);
+		for (int c = 0; mask; c++, mask >>= 1) {
+			if (!(mask & 1)) continue;
+			childActive[c] |= 1u << i;
+			entry[c][i] = t[c];
+			nearest[c] = fmin(nearest[c], t[c]);
+		}
+	}
+
+	int order[8];
+	int count = 0;
+	for (int c = 0; c < 8; c++) {
+		if (!childActive[c]) continue;
+		int k = count++;
+		for (; k > 0 && nearest[order[k - 1]] > nearest[c]; k--) {
+			order[k] = order[k - 1];
+		}
+		order[k] = c;
+	}
+
+	for (int k = 0; k < count; k++) {
+		int c = order[k];
+		uint32_t childRays = 0;
+		for (uint32_t m = childActive[c]; m; m &= m - 1) {
+			int i = lowestBit(m);
+			if (entry[c][i] < hits[i].t) childRays |= 1u << i;
+		}
+		if (childRays) intersect(rays, nodes[n].firstChild + c, childRays, entry[c], hits, firstLeaf);
+	}
+}
+
+void Octree::intersect(const Ray& ray, int n, float tEnter, RayHit& hit, RayHit& firstLeaf) const {
+	hit.visited++;
+	assertExpanded(n);
+
+	if (nodes[n].isLeaf()) {
+		intersectLeaf(ray, n, hit);
+		if (tEnter < firstLeaf.t) {
+			firstLeaf.node = n;
+			firstLeaf.t = tEnter;
+			firstLeaf.point = leafPoint(n);
+		}
+		return;
+	}
+	if (ownEnd(n) > nodes[n].begin) intersectLeaf(ray, n, hit);	// loose octree
+
+	// test all children at once, then sort the ones the ray enters by entry
+	// distance
+	float tChild[8];
+	int mask = childBounds[childBoundsIndex[n]].intersect(ray, 0, hit.t, tChild);
+	int order[8];
+	float entry[8];
+	int count = 0;
+	for (int c = 0; mask; c++, mask >>= 1) {
+		if (!(mask & 1)) continue;
+		float t = tChild[c];
+		int k = count++;
+		for (; k > 0 && entry[k - 1] > t; k--) {
+			order[k] = order[k - 1];
+			entry[k] = entry[k - 1];
+		}
+		order[k] = nodes[n].firstChild + c;
+		entry[k] = t;
+	}
+
+	for (int k = 0; k < count; k++) {
+		if (entry[k] >= hit.t) break;	// everything left is behind the hit
+		intersect(ray, order[k], entry[k], hit, firstLeaf);
+	}
+}
+
+// test the triangles of a node (face mode) or the triangles around the
+// vertices of a leaf
+//
+void Octree::intersectLeaf(const Ray& ray, int n, RayHit& hit) const {
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	const vector<ofIndexType>& indices = mesh.getIndices();
+	glm::vec3 origin(ray.origin.x(), ray.origin.y(), ray.origin.z());
+	glm::vec3 dir(ray.direction.x(), ray.direction.y(), ray.direction.z());
+
+	if (bUseFaces) {
+		for (int i = nodes[n].begin; i < ownEnd(n); i++) {
+			int f = pointIndex[i];
+			float t;
+			if (rayIntersectTriangle(origin, dir, verts[indices[3 * f]], verts[indices[3 * f + 1]],
+				verts[indices[3 * f + 2]], t) && t < hit.t) {
+				hit.node = n;
+				hit.face = f;
+				hit.t = t;
+				hit.point = origin + dir * t;
+			}
+		}
+		return;
+	}
+	if (vertexFaces.empty()) return;
+
+	for (int i = nodes[n].begin; i < nodes[n].end; i++) {
+		int v = pointIndex[i];
+		for (int j = vertexFaceStart[v]; j < vertexFaceStart[v + 1]; j++) {
+			int f = vertexFaces[j];
+			float t;
+			if (rayIntersectTriangle(origin, dir, verts[indices[3 * f]], verts[indices[3 * f + 1]],
+				verts[indices[3 * f + 2]], t) && t < hit.t) {
+				hit.node = n;
+				hit.face = f;
+				hit.t = t;
+				hit.point = origin + dir * t;
+			}
+		}
+	}
+}
+
+//  buildFaceBounds:  vertex to triangle adjacency and the bounds of the
+//                    triangles around every node's vertices (of the node's
+//                    triangles in a loose octree)
+//
+void Octree::buildFaceBounds() {
+	vertexFaceStart.clear();
+	vertexFaces.clear();
+	faceBounds.clear();
+	int numFaces = mesh.getNumIndices() / 3;
+	if (numFaces == 0) return;
+
+	// a loose octree holds the faces themselves and needs no adjacency
+	const vector<ofIndexType>& indices = mesh.getIndices();
+	if (!bUseFaces) {
+		buildVertexFaces(indices, numFaces);
+	}
+
+	// children always come after their parent, so walking backwards sees
+	// every child before its parent.  Only leaves and loose inner nodes own
+	// points, the rest is the union of the children
+	faceBounds.resize(nodes.size());
+	for (int n = nodes.size() - 1; n >= 0; n--) {
+		int first = nodes[n].firstChild;
+		bool bOwnPoints = ownEnd(n) > nodes[n].begin;
+		Box own = bOwnPoints ? fanBounds(nodes[n].begin, ownEnd(n)) : faceBounds[first];
+		Vector3 min = own.parameters[0];
+		Vector3 max = own.parameters[1];
+		for (int i = first; i < first + nodes[n].numChildren(); i++) {
+			const Box& b = faceBounds[i];
+			min = Vector3(fmin(min.x(), b.parameters[0].x()), fmin(min.y(), b.parameters[0].y()), fmin(min.z(), b.parameters[0].z()));
+			max = Vector3(fmax(max.x(), b.parameters[1].x()), fmax(max.y(), b.parameters[1].y()), fmax(max.z(), b.parameters[1].z()));
+		}
+		faceBounds[n] = Box(min, max);
+	}
+}
+
+// vertex to triangle adjacency in compressed rows
+//
+void Octree::buildVertexFaces(const vector<ofIndexType>& indices, int numFaces) {
+	vertexFaceStart.assign(mesh.getNumVertices() + 1, 0);
+	for (int i = 0; i < numFaces * 3; i++) {
+		vertexFaceStart[indices[i] + 1]++;
+	}
+	for (int i = 0; i < mesh.getNumVertices(); i++) {
+		vertexFaceStart[i + 1] += vertexFaceStart[i];
+	}
+	vertexFaces.resize(numFaces * 3);
+	vector<int> next(vertexFaceStart.begin(), vertexFaceStart.end() - 1);
+	for (int i = 0; i < numFaces * 3; i++) {
+		vertexFaces[next[indices[i]]++] = i / 3;
+	}
+}
+
+//  buildChildBounds:  SoA copy of the children's cullBounds() for every inner
+//                     node, in node order
+//
+void Octree::buildChildBounds() {
+	childBounds.clear();
+	childBoundsIndex.assign(nodes.size(), -1);
+	for (int n = 0; n < nodes.size(); n++) {
+		if (!nodes[n].isLeaf()) addChildBounds(n);
+	}
+}
+
+void Octree::addChildBounds(int n) {
+	childBoundsIndex[n] = childBounds.size();
+	childBounds.push_back(ChildBoxes8());
+	int first = nodes[n].firstChild;
+	for (int i = first; i < first + nodes[n].numChildren(); i++) {
+		childBounds.back().add(cullBounds(i));
+	}
+}
+
+// bounds of all triangles touching the points pointIndex[begin, end), or of
+// the triangles pointIndex[begin, end) in face mode
+//
+Box Octree::fanBounds(int begin, int end) const {
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	const vector<ofIndexType>& indices = mesh.getIndices();
+	if (bUseFaces) {
+		glm::vec3 min = faceVertex(pointIndex[begin], 0);
+		glm::vec3 max = min;
+		for (int i = begin; i < end; i++) {
+			for (int k = 0; k < 3; k++) {
+				min = glm::min(min, faceVertex(pointIndex[i], k));
+				max = glm::max(max, faceVertex(pointIndex[i], k));
+			}
+		}
+		return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	}
+
+	glm::vec3 min = verts[pointIndex[begin]];
+	glm::vec3 max = min;
+	for (int i = begin; i < end; i++) {
+		int v = pointIndex[i];
+		for (int j = vertexFaceStart[v]; j < vertexFaceStart[v + 1]; j++) {
+			int f = vertexFaces[j];
+			for (int k = 0; k < 3; k++) {
+				min = glm::min(min, verts[indices[3 * f + k]]);
+				max = glm::max(max, verts[indices[3 * f + k]]);
+			}
+		}
+	}
+	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+}
+
+// triangle face of the mesh overlaps box
+//
+bool Octree::faceOverlap(const Box& box, int face) const {
+	const glm::vec3& v0 = faceVertex(face, 0);
+	const glm::vec3& v1 = faceVertex(face, 1);
+	const glm::vec3& v2 = faceVertex(face, 2);
+	return box.overlap(Vector3(v0.x, v0.y, v0.z), Vector3(v1.x, v1.y, v1.z), Vector3(v2.x, v2.y, v2.z));
+}
+
+// octree intersect with box (linear layout).  The results go to ctx, whose
+// storage is reused from query to query
+//
+bool Octree::intersect(const Box& box, QueryContext& ctx) const {
+	return intersectFrom(box, 0, ctx);
+}
+
+bool Octree::intersect(const Box& box, QueryContext& ctx, CoherenceCache& cache) const {
+	return intersectFrom(box, startNode(box, cache), ctx);
+}
+
+// box query of the subtree at n, which must contain every node the box can
+// touch (the root, or startNode())
+//
+bool Octree::intersectFrom(const Box& box, int n, QueryContext& ctx) const {
+	ctx.begin();
+	if (bUseFaces) {
+		// a strict tree references a triangle from every leaf it overlaps
+		intersectFaces(box, n, ctx);
+		if (!bLoose) {
+			sort(ctx.points.begin(), ctx.points.end());
+			ctx.points.erase(unique(ctx.points.begin(), ctx.points.end()), ctx.points.end());
+		}
+	}
+	else if (nodes[n].box.overlap(box)) intersect(box, n, ctx);
+	ctx.end();
+	return ctx.hit();
+}
+
+bool Octree::intersect(const Box& box, int n, QueryContext& ctx) const {
+	bool intersects = false;
+
+	ctx.visited++;
+	assertExpanded(n);
+	if (nodes[n].isLeaf()) {
+		ctx.boxes.push_back(nodes[n].box);
+		ctx.points.push_back(pointIndex[nodes[n].begin]);
+		return true;
+	}
+
+	int first = nodes[n].firstChild;
+	int last = first + nodes[n].numChildren();
+	for (int i = first; i < last; i++) {
+		if (nodes[i].box.overlap(box)) {
+			if (intersect(box, i, ctx)) intersects = true;
+		}
+	}
+
+	return intersects;
+}
+
+// face mode box query: only nodes with a triangle actually touching the box
+// are returned, together with those triangles
+//
+bool Octree::intersectFaces(const Box& box, int n, QueryContext& ctx) const {
+	if (!cullBounds(n).overlap(box)) return false;
+	ctx.visited++;
+
+	bool contact = false;
+	for (int i = nodes[n].begin; i < ownEnd(n); i++) {
+		int f = pointIndex[i];
+		if (!faceOverlap(box, f)) continue;
+		contact = true;
+		ctx.points.push_back(f);
+	}
+	if (contact) ctx.boxes.push_back(nodes[n].box);
+
+	int first = nodes[n].firstChild;
+	int last = first + nodes[n].numChildren();
+	for (int i = first; i < last; i++) {
+		if (intersectFaces(box, i, ctx)) contact = true;
+	}
+	return contact;
+}
+
+//  sweep:  continuous collision of a moving box (linear layout).
+//
+//  Same front to back walk as the closest hit ray query: a node is entered at
+//  the first t the moving box touches its cullBounds(), children are visited
+//  in order of that t and skipped once a contact before it is known.  Leaves
+//  test their triangles with the swept separating axis test of Box::sweep(),
+//  so the result does not depend on how far the box moves in one step.
+//
+bool Octree::sweep(const Box& box, const glm::vec3& motion, SweepHit& hit) const {
+	hit = SweepHit();
+	Vector3 m(motion.x, motion.y, motion.z);
+	float tEnter;
+	if (box.sweep(m, cullBounds(0), 1, tEnter)) {
+		sweep(box, m, 0, tEnter, hit);
+	}
+	return hit.hit();
+}
+
+void Octree::sweep(const Box& box, const Vector3& motion, int n, float tEnter, SweepHit& hit) const {
+	hit.visited++;
+	assertExpanded(n);
+
+	if (bUseFaces || nodes[n].isLeaf()) {
+		int end = bUseFaces ? ownEnd(n) : nodes[n].end;
+		for (int i = nodes[n].begin; i < end; i++) {
+			int p = pointIndex[i];
+			if (bUseFaces) sweepFace(box, motion, n, p, hit);
+			else if (vertexFaces.empty()) sweepFace(box, motion, n, -p - 1, hit);	// point cloud
+			else {
+				for (int j = vertexFaceStart[p]; j < vertexFaceStart[p + 1]; j++) {
+					sweepFace(box, motion, n, vertexFaces[j], hit);
+				}
+			}
+		}
+		if (nodes[n].isLeaf()) return;
+	}
+
+	int order[8];
+	float entry[8];
+	int count = 0;
+	int first = nodes[n].firstChild;
+	for (int c = first; c < first + nodes[n].numChildren(); c++) {
+		float t;
+		if (!box.sweep(motion, cullBounds(c), hit.t, t)) continue;
+		int k = count++;
+		for (; k > 0 && entry[k - 1] > t; k--) {
+			order[k] = order[k - 1];
+			entry[k] = entry[k - 1];
+		}
+		order[k] = c;
+		entry[k] = t;
+	}
+
+	for (int k = 0; k < count; k++) {
+		if (entry[k] >= hit.t) break;
+		sweep(box, motion, order[k], entry[k], hit);
+	}
+}
+
+// swept test of one triangle, face = -v - 1 for the lone vertex v of a mesh
+// without faces
+//
+void Octree::sweepFace(const Box& box, const Vector3& motion, int n, int face, SweepHit& hit) const {
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	glm::vec3 a = (face >= 0) ? faceVertex(face, 0) : verts[-face - 1];
+	glm::vec3 b = (face >= 0) ? faceVertex(face, 1) : a;
+	glm::vec3 c = (face >= 0) ? faceVertex(face, 2) : a;
+	float t;
+	if (!box.sweep(motion, Vector3(a.x, a.y, a.z), Vector3(b.x, b.y, b.z), Vector3(c.x, c.y, c.z), hit.t, t)) return;
+
+	glm::vec3 m(motion.x(), motion.y(), motion.z());
+	Vector3 center = box.center();
+	glm::vec3 normal = (face >= 0) ? faceNormal(face, glm::vec3(center.x(), center.y(), center.z())) : glm::vec3(0);
+	if (glm::length(normal) == 0) normal = -m;
+
+	// already touching: only a contact when moving further in
+	if (t == 0 && glm::dot(m, normal) >= 0) return;
+
+	hit.node = n;
+	hit.face = (face >= 0) ? face : -1;
+	hit.t = t;
+	hit.normal = glm::normalize(normal);
+}
+
+//  overlap:  oriented box against the terrain (linear layout).  Nodes are
+//  culled with the box's world bounds first and the exact box test second;
+//  leaves test their triangles, and the walk ends at the first contact.
+//
+bool Octree::overlap(const OrientedBox& obb, int& faceRtn, const std::atomic<bool>* stop) const {
+	return overlap(obb, obb.bounds(), 0, faceRtn, stop);
+}
+
+bool Octree::overlap(const OrientedBox& obb, const Box& bounds, int n, int& faceRtn, const std::atomic<bool>* stop) const {
+	if (stop && *stop) return false;
+	if (!cullBounds(n).overlap(bounds) || !obb.overlap(cullBounds(n))) return false;
+	assertExpanded(n);
+
+	if (bUseFaces || nodes[n].isLeaf()) {
+		int end = bUseFaces ? ownEnd(n) : nodes[n].end;
+		for (int i = nodes[n].begin; i < end; i++) {
+			int p = pointIndex[i];
+			if (bUseFaces) {
+				if (obb.overlap(faceVertex(p, 0), faceVertex(p, 1), faceVertex(p, 2))) {
+					faceRtn = p;
+					return true;
+				}
+			}
+			else if (vertexFaces.empty()) {
+				if (obb.inside(mesh.getVertices()[p])) {
+					faceRtn = -1;
+					return true;
+				}
+			}
+			else {
+				for (int j = vertexFaceStart[p]; j < vertexFaceStart[p + 1]; j++) {
+					int f = vertexFaces[j];
+					if (obb.overlap(faceVertex(f, 0), faceVertex(f, 1), faceVertex(f, 2))) {
+						faceRtn = f;
+						return true;
+					}
+				}
+			}
+		}
+		if (nodes[n].isLeaf()) return false;
+	}
+
+	int first = nodes[n].firstChild;
+	for (int c = first; c < first + nodes[n].numChildren(); c++) {
+		if (overlap(obb, bounds, c, faceRtn, stop)) return true;
+	}
+	return false;
+}
+
+//  contacts:  the triangles a box overlaps, as a contact manifold (linear
+//  layout).  Same walk as the box query, but a triangle is only a contact
+//  when it actually overlaps the box, so the result does not depend on how
+//  deep the tree is.
+//
+int Octree::contacts(const Box& box, ContactManifold& manifold) const {
+	manifold.clear();
+	contacts(box, 0, manifold);
+	return manifold.count;
+}
+
+int Octree::contacts(const Box& box, ContactManifold& manifold, CoherenceCache& cache) const {
+	manifold.clear();
+	contacts(box, startNode(box, cache), manifold);
+	return manifold.count;
+}
+
+void Octree::contacts(const Box& box, int n, ContactManifold& manifold) const {
+	if (!cullBounds(n).overlap(box)) return;
+	assertExpanded(n);
+
+	if (bUseFaces) {
+		for (int i = nodes[n].begin; i < ownEnd(n); i++) {
+			addContact(box, pointIndex[i], manifold);
+		}
+	}
+	else if (nodes[n].isLeaf() && !vertexFaces.empty()) {
+		for (int i = nodes[n].begin; i < nodes[n].end; i++) {
+			int v = pointIndex[i];
+			for (int j = vertexFaceStart[v]; j < vertexFaceStart[v + 1]; j++) {
+				addContact(box, vertexFaces[j], manifold);
+			}
+		}
+	}
+
+	int first = nodes[n].firstChild;
+	for (int c = first; c < first + nodes[n].numChildren(); c++) {
+		contacts(box, c, manifold);
+	}
+}
+
+static bool strictlyInside(const Box& outer, const Box& inner) {
+	for (int i = 0; i < 3; i++) {
+		if (inner.min()[i] <= outer.min()[i] || inner.max()[i] >= outer.max()[i]) return false;
+	}
+	return true;
+}
+
+// shrink valid on the side where region is farthest from b, so it no longer
+// reaches b.  region does not overlap b, so that gap is positive
+//
+static void exclude(Box& valid, const Box& region, const Box& b) {
+	int axis = 0;
+	bool below = false;
+	float gap = -FLT_MAX;
+	for (int i = 0; i < 3; i++) {
+		if (b.min()[i] - region.max()[i] > gap) {
+			gap = b.min()[i] - region.max()[i];
+			axis = i;
+			below = false;
+		}
+		if (region.min()[i] - b.max()[i] > gap) {
+			gap = region.min()[i] - b.max()[i];
+			axis = i;
+			below = true;
+		}
+	}
+	float lo[3] = { valid.min().x(), valid.min().y(), valid.min().z() };
+	float hi[3] = { valid.max().x(), valid.max().y(), valid.max().z() };
+	if (below) lo[axis] = std::max(lo[axis], b.max()[axis]);
+	else hi[axis] = std::min(hi[axis], b.min()[axis]);
+	valid = Box(Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]));
+}
+
+//  startNode:  walk the cached path up until region is inside the valid box
+//              of its last node, then down while region reaches only one of
+//              the children, shrinking the valid box to keep it clear of the
+//              other ones
+//
+int Octree::startNode(const Box& region, CoherenceCache& cache) const {
+	if (bLoose || nodes.empty()) return 0;
+	if (cache.octree != this || cache.generation != generation) {
+		cache.reset();
+		cache.octree = this;
+		cache.generation = generation;
+	}
+	if (cache.depth == 0) {
+		cache.path[0] = 0;
+		cache.valid[0] = Box(Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX), Vector3(FLT_MAX, FLT_MAX, FLT_MAX));
+		cache.depth = 1;
+	}
+	cache.queries++;
+
+	int up = 0;
+	while (cache.depth > 1 && !strictlyInside(cache.valid[cache.depth - 1], region)) {
+		cache.depth--;
+		up++;
+	}
+	if (up == 0 && cache.depth > 1) cache.hits++;
+	cache.walkUps += up;
+
+	while (cache.depth < CoherenceCache::maxDepth) {
+		int n = cache.path[cache.depth - 1];
+		assertExpanded(n);
+		if (nodes[n].isLeaf()) break;
+
+		// box queries test the cells, rays and contacts cullBounds()
+		int first = nodes[n].firstChild;
+		int last = first + nodes[n].numChildren();
+		int next = -1;
+		for (int c = first; c < last && next != -2; c++) {
+			if (nodes[c].box.overlap(region) || cullBounds(c).overlap(region)) {
+				next = next == -1 ? c : -2;
+			}
+		}
+		if (next < 0) break;
+
+		Box valid = cache.valid[cache.depth - 1];
+		for (int c = first; c < last; c++) {
+			if (c == next) continue;
+			exclude(valid, region, nodes[c].box);
+			exclude(valid, region, cullBounds(c));
+		}
+		cache.path[cache.depth] = next;
+		cache.valid[cache.depth] = valid;
+		cache.depth++;
+		cache.descents++;
+	}
+	return cache.path[cache.depth - 1];
+}
+
+//  addContact:  penetration of the box below the triangle's plane, measured
+//               from the box corner deepest along the normal
+//
+void Octree::addContact(const Box& box, int face, ContactManifold& manifold) const {
+	const glm::vec3& a = faceVertex(face, 0);
+	const glm::vec3& b = faceVertex(face, 1);
+	const glm::vec3& c = faceVertex(face, 2);
+	if (!box.overlap(Vector3(a.x, a.y, a.z), Vector3(b.x, b.y, b.z), Vector3(c.x, c.y, c.z))) return;
+
+	Vector3 center = box.center();
+	Contact contact;
+	contact.normal = faceNormal(face, glm::vec3(center.x(), center.y(), center.z()));
+	if (glm::length(contact.normal) == 0) return;	// degenerate triangle
+
+	const glm::vec3& n = contact.normal;
+	glm::vec3 corner;
+	for (int i = 0; i < 3; i++) {
+		corner[i] = (n[i] > 0) ? box.min()[i] : box.max()[i];
+	}
+	contact.depth = glm::dot(a - corner, n);
+	contact.point = corner + n * contact.depth;
+	contact.face = face;
+	manifold.add(contact);
+}
+
+// unit normal of a triangle, flipped to face the point toward
+//
+glm::vec3 Octree::faceNormal(int face, const glm::vec3& toward) const {
+	const glm::vec3& a = faceVertex(face, 0);
+	glm::vec3 n = glm::cross(faceVertex(face, 1) - a, faceVertex(face, 2) - a);
+	if (glm::dot(n, toward - a) < 0) n = -n;
+	float length = glm::length(n);
+	return (length > 0) ? n / length : n;
+}
+
+// keep the maxContacts deepest contacts, each triangle once (in vertex mode
+// a triangle is reached from all of its vertices)
+//
+void ContactManifold::add(const Contact& c) {
+	int shallowest = 0;
+	for (int i = 0; i < count; i++) {
+		if (contacts[i].face == c.face) return;
+		if (contacts[i].depth < contacts[shallowest].depth) shallowest = i;
+	}
+	if (count < maxContacts) contacts[count++] = c;
+	else if (c.depth > contacts[shallowest].depth) contacts[shallowest] = c;
+}
+
+glm::vec3 ContactManifold::normal() const {
+	glm::vec3 sum(0, 0, 0);
+	for (int i = 0; i < count; i++) {
+		sum += contacts[i].normal * fmax(contacts[i].depth, 1e-4f);
+	}
+	float length = glm::length(sum);
+	return (length > 0) ? sum / length : sum;
+}
+
+float ContactManifold::depth() const {
+	float deepest = 0;
+	for (int i = 0; i < count; i++) {
+		deepest = fmax(deepest, contacts[i].depth);
+	}
+	return deepest;
+}
+
+void Octree::draw(int n, int numLevels, int level) {
+	if (level >= numLevels) return;
+
+	ofSetColor(getColor(level));
+	drawBox(nodes[n].box);
+
+	int last = nodes[n].firstChild + nodes[n].numChildren();
+	for (int i = nodes[n].firstChild; i < last; i++) {
+		draw(i, numLevels, level + 1);
+	}
+}
+
+// memory held by the octree structure (not counting the mesh copy)
+//
+size_t Octree::memoryUsage() const {
+	size_t bytes = memoryUsage(root) - sizeof(TreeNode);
+	bytes += nodes.capacity() * sizeof(FlatNode);
+	bytes += pointIndex.capacity() * sizeof(int);
+	bytes += (vertexFaceStart.capacity() + vertexFaces.capacity()) * sizeof(int);
+	bytes += faceBounds.capacity() * sizeof(Box);
+	bytes += leafNodes.capacity() * sizeof(int);
+	bytes += childBounds.capacity() * sizeof(ChildBoxes8) + childBoundsIndex.capacity() * sizeof(int);
+	return bytes;
+}
+
+size_t Octree::memoryUsage(const TreeNode& node) {
+	size_t bytes = sizeof(TreeNode) + node.points.capacity() * sizeof(int);
+	bytes += (node.children.capacity() - node.children.size()) * sizeof(TreeNode);
+	for (const TreeNode& child : node.children) {
+		bytes += memoryUsage(child);
+	}
+	return bytes;
+}
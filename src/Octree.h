@@ -12,8 +12,13 @@
 #include "ofMain.h"
 #include "box.h"
 #include "ray.h"
+#include "ChildBoxes.h"
+#include "OrientedBox.h"
+#include "ThreadPool.h"
+#include "Random.h"
 #include "ofUtils.h"
 #include <vector>
+#include <cfloat>
 
 
 class TreeNode {
@@ -23,41 +28,376 @@ public:
 	vector<TreeNode> children;
 };
 
+// Node of the linear (flat) octree layout.  All nodes live in one contiguous
+// array: the children of a node occupy consecutive slots starting at
+// firstChild, and bit i of childMask is set when octant i is present.  The
+// points of a node are the slice [begin, end) of Octree::pointIndex (in face
+// mode the slice holds triangle indices instead of vertex indices).  The slice
+// covers the whole subtree; points stored at the node itself, which only a
+// loose octree has for inner nodes, come before the first child's slice.
+//
+class FlatNode {
+public:
+	Box box;
+	int firstChild = -1;
+	int begin = 0;
+	int end = 0;
+	unsigned char childMask = 0;
+	unsigned char level = 0;	// depth as counted by subdivide(), root = 1
+
+	bool isLeaf() const { return childMask == 0; }
+	int numChildren() const { return bitCount(childMask); }
+	int numPoints() const { return end - begin; }	// points or faces
+
+	static int bitCount(unsigned char mask) {
+		int n = 0;
+		for (; mask; mask &= mask - 1) n++;
+		return n;
+	}
+};
+
+// result of a closest hit ray query
+//
+class RayHit {
+public:
+	int node = -1;		// leaf the hit was found in
+	int face = -1;		// triangle hit, -1 when the mesh has no faces (vertex hit)
+	float t = FLT_MAX;	// distance along the ray direction
+	glm::vec3 point;
+	int visited = 0;	// nodes visited by the query
+
+	bool hit() const { return node >= 0; }
+};
+
+// result of a swept box query
+//
+class SweepHit {
+public:
+	int node = -1;		// leaf the triangle was found in
+	int face = -1;		// first triangle touched, -1 for a vertex of a mesh without faces
+	float t = 1;		// fraction of the motion travelled before contact
+	glm::vec3 normal;	// triangle normal, facing the box
+	int visited = 0;	// nodes visited by the query
+
+	bool hit() const { return node >= 0; }
+};
+
+// reusable result storage of box queries.  begin() empties the lists but
+// keeps their capacity, so it only grows to the largest result seen (the
+// high water mark) and once there a query allocates nothing.  reserve()
+// preallocates it up front
+//
+class QueryContext {
+public:
+	vector<Box> boxes;	// leaf boxes (face mode: boxes of the nodes with touching triangles)
+	vector<int> points;	// their points (face mode: triangles)
+
+	int visited = 0;	// nodes visited by the last query
+	int hits = 0;		// boxes returned by the last query
+	size_t highWater = 0;	// most results a query has returned
+	int grows = 0;		// queries that had to enlarge the storage
+
+	void reserve(size_t n) {
+		boxes.reserve(n);
+		points.reserve(n);
+	}
+	void begin() {
+		boxes.clear();
+		points.clear();
+		visited = 0;
+		hits = 0;
+		capacity = boxes.capacity() + points.capacity();
+	}
+	void end() {
+		hits = boxes.size();
+		highWater = std::max(highWater, std::max(boxes.size(), points.size()));
+		if (boxes.capacity() + points.capacity() != capacity) grows++;
+	}
+	bool hit() const { return !boxes.empty(); }
+
+private:
+	size_t capacity = 0;
+};
+
+// one touching triangle of a box query
+//
+class Contact {
+public:
+	glm::vec3 point;	// deepest point of the box, moved onto the triangle's plane
+	glm::vec3 normal;	// triangle normal, facing the box
+	float depth = 0;	// how far the box sinks below the triangle along normal
+	int face = -1;
+};
+
+// the deepest contacts of a box with the terrain, at most maxContacts of them
+// whatever the octree depth or mesh resolution
+//
+class ContactManifold {
+public:
+	static const int maxContacts = 8;
+	Contact contacts[maxContacts];
+	int count = 0;
+
+	void clear() { count = 0; }
+	bool empty() const { return count == 0; }
+	void add(const Contact& c);
+	glm::vec3 normal() const;	// depth weighted average of the contact normals
+	float depth() const;		// deepest penetration
+};
+
+class Octree;
+
+// temporal coherence of a query that moves only a little from one frame to
+// the next (the lander's altitude ray or its box): the path from the root to
+// the deepest node that fully contained the last query region.  The next
+// query starts at the end of the path and walks up only as far as it has to
+// when the region left that node, so its cost no longer grows with the depth
+// of the tree.  One cache per kind of query
+//
+// "Contained" is measured against valid[i] rather than the node's cell: a
+// lander box on a flat terrain straddles the middle of almost every cell, but
+// as long as it stays clear of the cells and cullBounds() of the siblings on
+// the path nothing outside the subtree can take part in the query
+//
+class CoherenceCache {
+public:
+	static const int maxDepth = 64;
+	int path[maxDepth];
+	Box valid[maxDepth];	// a region strictly inside valid[i] only reaches the subtree of path[i]
+	int depth = 0;		// 0: empty, the next query starts at the root
+	float lastT = -1;	// ray queries: distance of the last hit, -1 for none
+
+	int queries = 0;
+	int hits = 0;		// queries whose region was still inside the cached node
+	int walkUps = 0;	// levels walked up
+	int descents = 0;	// levels walked down
+	int fallbacks = 0;	// ray queries that missed below the cached node and restarted at the root
+
+	float hitRate() const { return queries ? hits / (float)queries : 0; }
+	void reset() {
+		depth = 0;
+		lastT = -1;
+	}
+	void resetCounters() { queries = hits = walkUps = descents = fallbacks = 0; }
+
+	// tree the path belongs to, rebuilding it (create()) invalidates the path
+	const Octree* octree = nullptr;
+	int generation = -1;
+};
+
 class Octree {
 public:
 
 	void create(const ofMesh& mesh, int numLevels);
 	void subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int level);
 	void generateLandingAreas();
+	void generateLandingAreas(const TreeNode& node, Rng& rng);
 	void createLanding(glm::vec3 point);
-	bool intersect(const Ray&, const TreeNode& node, TreeNode& nodeRtn);
+	bool intersect(const Ray&, const TreeNode& node, const TreeNode*& nodeRtn);
 	bool intersect(const Box&, TreeNode& node, vector<Box>& boxListRtn, vector<int>& pointListRtn);
 	void draw(TreeNode& node, int numLevels, int level);
 	void draw(int numLevels, int level) {
-		draw(root, numLevels, level);
+		if (bFlatLayout) draw(0, numLevels, level);
+		else draw(root, numLevels, level);
 	}
 	static void drawBox(const Box& box);
 	static Box meshBounds(const ofMesh&);
 	int getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points, Box& box, vector<int>& pointsRtn);
 	int getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces, Box& box, vector<int>& facesRtn);
 	void subDivideBox8(const Box& b, vector<Box>& boxList);
+	static int octant(const Vector3& p, const Vector3& center);
+
+	// linear layout - node 0 is the root
+	//
+	void subdivide(const ofMesh& mesh, vector<FlatNode>& tree, int node, int numLevels, int level);
+	void partition(const ofMesh& mesh, vector<FlatNode>& tree, int node);
+	void subdivideFaces(const ofMesh& mesh, int node, vector<int>& faces, int numLevels, int level);
+	void subdivideLoose(const ofMesh& mesh, int node, int numLevels, int level);
+	void partitionLoose(const ofMesh& mesh, int node);
+	int looseOctant(int face, const Vector3& center, const Box* looseCells) const;
+	void buildSubtree(const ofMesh& mesh, vector<FlatNode>& tree, int numLevels, int level);
+	static void splice(vector<FlatNode>& tree, int node, const vector<FlatNode>& subtree);
+	void expand(int node);
+	void expandAll();
+	uint64_t cacheKey(int numLevels) const;
+	bool save(const string& path, uint64_t key) const;
+	bool load(const string& path, uint64_t key);
+	// triangles to test: a face mode tree, or vertices with triangles around
+	// them.  Without them ray queries report vertex hits
+	bool hasFaces() const { return bUseFaces || !vertexFaces.empty(); }
+	bool isUnexpanded(int n) const {
+		return bLazy && !bUseFaces && nodes[n].isLeaf() && nodes[n].numPoints() > 1 && nodes[n].level < levels;
+	}
+
+	// queries on the linear layout are const: all their state lives on the
+	// stack and in the result arguments, so any number of threads may run them
+	// at once while nobody modifies the tree.  They need a complete tree: a
+	// lazy one (bLazy) goes through the non-const queries further down, or is
+	// completed with expandAll() first
+	void assertExpanded(int n) const {
+		assert(!isUnexpanded(n));
+	}
+	bool intersect(const Ray&, int node, int& nodeRtn) const;
+	bool intersect(const Box&, QueryContext& ctx) const;
+	bool intersect(const Box&, int node, QueryContext& ctx) const;
+	bool intersect(const Ray&, RayHit& hit, float tMax = 10000.0) const;
+	bool intersect(const Ray&, RayHit& hit, CoherenceCache& cache, float tMax = 10000.0) const;
+	bool intersect(const Box&, QueryContext& ctx, CoherenceCache& cache) const;
+	bool intersectFrom(const Box&, int node, QueryContext& ctx) const;
+	void intersect(const Ray&, int node, float tEnter, RayHit& hit, RayHit& firstLeaf) const;
+	void intersectLeaf(const Ray&, int node, RayHit& hit) const;
+	void vertexHit(const Ray&, RayHit& hit, RayHit& firstLeaf) const;
+
+	// packet queries: closest hit for each of rays[0 .. numRays), traversed in
+	// packets of rayPacketSize consecutive rays that share their node visits.
+	// Neighbouring rays should be close (sweeps, grids) for the sharing to pay
+	// off.  Returns the number of rays that hit
+	static const int rayPacketSize = 32;
+	int intersect(const Ray* rays, int numRays, RayHit* hits, float tMax = 10000.0) const;
+	void intersectPacket(const Ray* rays, int count, RayHit* hits, float tMax) const;
+	void intersect(const Ray* rays, int node, uint32_t active, const float* tEnter, RayHit* hits, RayHit* firstLeaf) const;
+	bool intersectFaces(const Box&, int node, QueryContext& ctx) const;
+
+	// swept box: the first triangle the box touches while it moves by
+	// motion * t, t in [0, 1).  Triangles the box already overlaps at t = 0
+	// only count when it moves further into them, so a box resting on the
+	// terrain can still slide along or lift off it
+	bool sweep(const Box&, const glm::vec3& motion, SweepHit& hit) const;
+	void sweep(const Box&, const Vector3& motion, int node, float tEnter, SweepHit& hit) const;
+	void sweepFace(const Box&, const Vector3& motion, int node, int face, SweepHit& hit) const;
+
+	// oriented box: true as soon as one triangle (a vertex for a mesh without
+	// faces) touching it is found, which is returned in faceRtn.  The search
+	// gives up early, returning false, once *stop is set by another thread
+	bool overlap(const OrientedBox&, int& faceRtn, const std::atomic<bool>* stop = nullptr) const;
+	bool overlap(const OrientedBox&, const Box& bounds, int node, int& faceRtn, const std::atomic<bool>* stop) const;
+
+	// contact manifold of a box with the triangles it overlaps (meshes
+	// without faces have no normals and give no contacts).  Returns the
+	// number of contacts
+	int contacts(const Box&, ContactManifold& manifold) const;
+	int contacts(const Box&, ContactManifold& manifold, CoherenceCache& cache) const;
+	void contacts(const Box&, int node, ContactManifold& manifold) const;
+	void addContact(const Box&, int face, ContactManifold& manifold) const;
+	glm::vec3 faceNormal(int face, const glm::vec3& toward) const;
+	bool faceOverlap(const Box& box, int face) const;
+	const glm::vec3& faceVertex(int face, int k) const {
+		return mesh.getVertices()[mesh.getIndices()[3 * face + k]];
+	}
+	const glm::vec3& leafPoint(int n) const {
+		int i = pointIndex[nodes[n].begin];
+		return bUseFaces ? faceVertex(i, 0) : mesh.getVertices()[i];
+	}
+	// coherent queries: the deepest node below which everything region can
+	// touch is referenced, found from the cached path.  A loose tree also
+	// stores faces in the inner nodes above it, so it always starts at the root
+	int startNode(const Box& region, CoherenceCache& cache) const;
+	// coherent ray: how far past last frame's hit it searches first
+	float probeLength(const CoherenceCache& cache, float tMax) const {
+		return std::min(tMax, cache.lastT * 1.25f + 0.01f * width);
+	}
+
+	// lazy mode: the same queries on a tree that is not complete yet.  Each
+	// one subdivides the nodes the query can reach, then runs the const
+	// query.  On a complete tree they only cost the bLazy check
+	bool intersect(const Ray&, int node, int& nodeRtn);
+	bool intersect(const Ray&, RayHit& hit, float tMax = 10000.0);
+	bool intersect(const Ray&, RayHit& hit, CoherenceCache& cache, float tMax = 10000.0);
+	int intersect(const Ray* rays, int numRays, RayHit* hits, float tMax = 10000.0);
+	bool intersect(const Box&, QueryContext& ctx);
+	bool intersect(const Box&, QueryContext& ctx, CoherenceCache& cache);
+	bool sweep(const Box&, const glm::vec3& motion, SweepHit& hit);
+	bool overlap(const OrientedBox&, int& faceRtn, const std::atomic<bool>* stop = nullptr);
+	int contacts(const Box&, ContactManifold& manifold);
+	int contacts(const Box&, ContactManifold& manifold, CoherenceCache& cache);
+	void expandRegion(const Box& region, int node = 0);
+	void expandAlong(const Ray&, float tMax, int node = 0);
+	void buildFaceBounds();
+	void buildVertexFaces(const vector<ofIndexType>& indices, int numFaces);
+	void buildChildBounds();
+	void addChildBounds(int node);
+	Box fanBounds(int begin, int end) const;
+	int ownEnd(int n) const {
+		return nodes[n].isLeaf() ? nodes[n].end : nodes[nodes[n].firstChild].begin;
+	}
+	const Box& cullBounds(int n) const {
+		return faceBounds.empty() ? nodes[n].box : faceBounds[n];
+	}
+	void draw(int node, int numLevels, int level);
+	size_t memoryUsage() const;
+	static size_t memoryUsage(const TreeNode& node);
 
 	ofMesh mesh;
 	TreeNode root;
-	vector<TreeNode> leafNodes;
+	vector<int> leafNodes;		// flat layout: index of every leaf in nodes
 	float width, length, height, fat;
+	// face mode: leaves hold triangles instead of vertices.  A triangle is
+	// referenced by every leaf box it overlaps, and a node stops splitting at
+	// maxFacesPerLeaf triangles.  Always built eagerly and serially: pool is
+	// ignored, and create() warns and clears bLazy when it is set
 	bool bUseFaces = false;
+	int maxFacesPerLeaf = 8;
+
+	// loose octree (face mode only): every triangle is stored exactly once, in
+	// the deepest node whose child cell grown by looseness contains its bounds.
+	// Queries cull with faceBounds, the actual extent of each subtree
+	bool bLoose = false;
+	float looseness = 2.0;
+	bool bFlatLayout = false;	// build into nodes/pointIndex instead of root
+
+	vector<FlatNode> nodes;
+	vector<int> pointIndex;
+
+	// triangles around each vertex: faces of vertex i are
+	// vertexFaces[vertexFaceStart[i] .. vertexFaceStart[i + 1])
+	vector<int> vertexFaceStart;
+	vector<int> vertexFaces;
+	vector<Box> faceBounds;		// per node: bounds of the triangles around its points (of its triangles in a loose octree)
+
+	// cullBounds() of the children of every inner node, for testing a ray
+	// against all of them at once: node n's block is childBounds[childBoundsIndex[n]]
+	vector<ChildBoxes8> childBounds;
+	vector<int> childBoundsIndex;	// -1 for leaves
+
+	// parallel build of the linear layout: levels down to parallelLevels fan
+	// out as tasks onto pool (serial build when pool is not set).  Subtrees
+	// of fewer than parallelGrain points are built inline: every level that
+	// fans out copies its subtrees once more when they are spliced back
+	ThreadPool* pool = nullptr;
+	int parallelLevels = 4;
+	int parallelGrain = 4096;
+
+	// lazy mode: create() only sets up the root, nodes are subdivided the first
+	// time a query reaches them and stay cached for later queries
+	bool bLazy = false;
+	int levels = 0;
+
+	// bumped by every create(), invalidates CoherenceCache paths into the old tree
+	int generation = 0;
+
+	// binary cache of the (eager) flat layout, keyed by cacheKey(); create()
+	// loads it when valid and (re)writes it otherwise.  sourcePath is the
+	// model file the mesh was loaded from: when set, the key is its path,
+	// size and modification time instead of a hash of the mesh
+	string cachePath;
+	string sourcePath;
+	bool bLoadedFromCache = false;
 
 	vector<Box> landingAreas;
 	vector<glm::vec3> landingPoints;
 	float landingWidth = 10;
 	int nLandings = 0;
 	int maxLandings = 3;
+	uint64_t seed = 1;	// the same seed and stream pick the same landing areas
+	uint64_t landingStream = 0;	// one per terrain, see rngStream(RngLanding, ...)
 
 	// debug;
 	//
 	int strayVerts = 0;
 	int numLeaf = 0;
+	int buildTime = 0;	// ms
+	int expandCount = 0;	// lazy mode: nodes subdivided by queries
+	uint64_t expandTime = 0;	// lazy mode: us spent subdividing
 
 	ofColor getColor(int level) {
 		return ofColor::fromHsb((level * 30) % 255, 255, 255);
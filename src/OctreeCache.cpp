@@ -0,0 +1,240 @@
+//  Octree binary cache - save and load the flat layout
+//
+//  File layout (native byte order):
+//     CacheHeader
+//     CacheNode  nodes[numNodes]
+//     int32      pointIndex[numPoints]
+//     float      vertices[storedVerts][3]
+//
+//  The header carries the cache key and an FNV-1a checksum of everything
+//  after it.  A file with the wrong magic, version, key, size or checksum is
+//  rejected and rebuilt.  In face mode pointIndex holds triangle indices.
+//
+//  With sourcePath set the key is the model file's path, size and
+//  modification time, and the vertices are not stored: a warm start only
+//  stats the model file and never touches the mesh data.  Without it the key
+//  hashes the mesh, and the stored vertices are compared with the mesh to
+//  rule out a hash collision.  Either way the key also covers the level
+//  count, the face mode settings and the format version.
+//
+//  The mapping is only read through: load() copies the nodes and point
+//  indices into the octree's own vectors.  What a warm start saves is the
+//  subdivision (and with sourcePath the mesh hashing), not the model parse,
+//  which the renderer needs anyway, or the copy.
+//
+
+#include "Octree.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+static const char cacheMagic[8] = { 'S', 'L', 'O', 'C', 'T', 'R', 'E', 'E' };
+static const uint32_t cacheVersion = 3;
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	int32_t levels;
+	uint64_t key;
+	uint64_t checksum;
+	int32_t numNodes;
+	int32_t numPoints;
+	int32_t numVerts;
+	int32_t storedVerts;	// numVerts, or 0 for a key on the model file
+	float bounds[6];
+};
+
+struct CacheNode {
+	float min[3];
+	float max[3];
+	int32_t firstChild;
+	int32_t begin;
+	int32_t end;
+	uint8_t childMask;
+	uint8_t level;
+	uint8_t pad[2];
+};
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vertices are written as packed floats");
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// size and modification time of the model file, false when there is none
+//
+static bool sourceStamp(const string& path, int64_t stamp[2]) {
+	struct stat info;
+	if (path.empty() || stat(path.c_str(), &info) != 0) return false;
+	stamp[0] = info.st_size;
+	stamp[1] = info.st_mtime;
+	return true;
+}
+
+// cache key: the model file's path, size and modification time, or a hash of
+// the mesh vertices and faces when there is no model file, plus the level
+// count, the face mode settings and the file version
+//
+uint64_t Octree::cacheKey(int numLevels) const {
+	int faceLimit = bUseFaces ? maxFacesPerLeaf : 0;
+	float loose = (bUseFaces && bLoose) ? looseness : 0;
+	int64_t stamp[2];
+	uint64_t hash;
+	if (sourceStamp(sourcePath, stamp)) {
+		hash = fnv1a(sourcePath.data(), sourcePath.size());
+		hash = fnv1a(stamp, sizeof(stamp), hash);
+	}
+	else {
+		const vector<glm::vec3>& verts = mesh.getVertices();
+		const vector<ofIndexType>& indices = mesh.getIndices();
+		hash = fnv1a(verts.data(), verts.size() * sizeof(glm::vec3));
+		hash = fnv1a(indices.data(), indices.size() * sizeof(ofIndexType), hash);
+	}
+	hash = fnv1a(&numLevels, sizeof(numLevels), hash);
+	hash = fnv1a(&faceLimit, sizeof(faceLimit), hash);
+	hash = fnv1a(&loose, sizeof(loose), hash);
+	return fnv1a(&cacheVersion, sizeof(cacheVersion), hash);
+}
+
+bool Octree::save(const string& path, uint64_t key) const {
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	int64_t stamp[2];
+	int storedVerts = sourceStamp(sourcePath, stamp) ? 0 : verts.size();
+
+	vector<CacheNode> records(nodes.size());
+	for (int i = 0; i < nodes.size(); i++) {
+		const FlatNode& node = nodes[i];
+		CacheNode& record = records[i];
+		memset(&record, 0, sizeof(record));
+		for (int k = 0; k < 3; k++) {
+			record.min[k] = node.box.parameters[0][k];
+			record.max[k] = node.box.parameters[1][k];
+		}
+		record.firstChild = node.firstChild;
+		record.begin = node.begin;
+		record.end = node.end;
+		record.childMask = node.childMask;
+		record.level = node.level;
+	}
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.levels = levels;
+	header.key = key;
+	header.numNodes = nodes.size();
+	header.numPoints = pointIndex.size();
+	header.numVerts = verts.size();
+	header.storedVerts = storedVerts;
+	for (int k = 0; k < 3; k++) {
+		header.bounds[k] = nodes[0].box.parameters[0][k];
+		header.bounds[k + 3] = nodes[0].box.parameters[1][k];
+	}
+	header.checksum = fnv1a(records.data(), records.size() * sizeof(CacheNode));
+	header.checksum = fnv1a(pointIndex.data(), pointIndex.size() * sizeof(int), header.checksum);
+	header.checksum = fnv1a(verts.data(), storedVerts * sizeof(glm::vec3), header.checksum);
+
+	// write next to the cache and swap it in, so a crash never leaves half a file
+	string tmpPath = path + ".tmp";
+	ofstream out(tmpPath, ios::binary | ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)records.data(), records.size() * sizeof(CacheNode));
+	out.write((const char*)pointIndex.data(), pointIndex.size() * sizeof(int));
+	out.write((const char*)verts.data(), storedVerts * sizeof(glm::vec3));
+	out.close();
+	if (!out) {
+		cout << "Octree cache: cannot write " << tmpPath << endl;
+		remove(tmpPath.c_str());
+		return false;
+	}
+	remove(path.c_str());
+	return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+//  load:  map the cache file and copy its nodes and point indices.
+//         Returns false (leaving the octree untouched) when the file is
+//         missing, stale or corrupted.
+//
+bool Octree::load(const string& path, uint64_t key) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+
+	CacheHeader header;
+	if (file.size() < sizeof(header)) {
+		cout << "Octree cache: " << path << " is truncated, rebuilding" << endl;
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+
+	// vertex mode indexes every vertex exactly once, face mode may repeat faces
+	const vector<glm::vec3>& verts = mesh.getVertices();
+	int numRefs = bUseFaces ? mesh.getNumIndices() / 3 : verts.size();
+	if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+		header.key != key || header.levels != levels || header.numVerts != verts.size() ||
+		(header.storedVerts != 0 && header.storedVerts != header.numVerts) ||
+		(!bUseFaces && header.numPoints != numRefs) || header.numPoints < 0 || header.numNodes <= 0) {
+		cout << "Octree cache: " << path << " is stale, rebuilding" << endl;
+		return false;
+	}
+
+	size_t nodeBytes = (size_t)header.numNodes * sizeof(CacheNode);
+	size_t pointBytes = (size_t)header.numPoints * sizeof(int);
+	size_t vertBytes = (size_t)header.storedVerts * sizeof(glm::vec3);
+	const char* payload = file.data() + sizeof(header);
+	if (file.size() != sizeof(header) + nodeBytes + pointBytes + vertBytes ||
+		fnv1a(payload, nodeBytes + pointBytes + vertBytes) != header.checksum) {
+		cout << "Octree cache: " << path << " is corrupted, rebuilding" << endl;
+		return false;
+	}
+
+	// a key on the mesh is a hash - make sure the cached vertices really are
+	// ours (none are stored for a key on the model file)
+	const CacheNode* records = (const CacheNode*)payload;
+	const int* points = (const int*)(payload + nodeBytes);
+	const char* cachedVerts = payload + nodeBytes + pointBytes;
+	if (memcmp(cachedVerts, verts.data(), vertBytes) != 0) {
+		cout << "Octree cache: " << path << " belongs to another mesh, rebuilding" << endl;
+		return false;
+	}
+
+	vector<FlatNode> cachedNodes(header.numNodes);
+	for (int i = 0; i < header.numNodes; i++) {
+		const CacheNode& record = records[i];
+		FlatNode& node = cachedNodes[i];
+		node.box = Box(Vector3(record.min[0], record.min[1], record.min[2]),
+			Vector3(record.max[0], record.max[1], record.max[2]));
+		node.firstChild = record.firstChild;
+		node.begin = record.begin;
+		node.end = record.end;
+		node.childMask = record.childMask;
+		node.level = record.level;
+
+		// never trust indices read from disk.  Leaves are never empty
+		// (leafPoint() reads their first point)
+		if (node.begin < 0 || node.begin > node.end || node.end > header.numPoints ||
+			(node.isLeaf() && node.begin == node.end) ||
+			(!node.isLeaf() && (node.firstChild <= i || node.firstChild + node.numChildren() > header.numNodes))) {
+			cout << "Octree cache: " << path << " has invalid nodes, rebuilding" << endl;
+			return false;
+		}
+	}
+
+	for (int i = 0; i < header.numPoints; i++) {
+		if (points[i] < 0 || points[i] >= numRefs) {
+			cout << "Octree cache: " << path << " has invalid points, rebuilding" << endl;
+			return false;
+		}
+	}
+
+	nodes.swap(cachedNodes);
+	pointIndex.assign(points, points + header.numPoints);
+	return true;
+}
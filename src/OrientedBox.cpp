@@ -0,0 +1,95 @@
+//  Oriented bounding box - see OrientedBox.h
+//
+
+#include "OrientedBox.h"
+
+OrientedBox::OrientedBox(const Box& local, const glm::mat4& transform) {
+	Vector3 c = local.center();
+	Vector3 h = (local.max() - local.min()) * 0.5;
+	glm::vec4 p = transform * glm::vec4(c.x(), c.y(), c.z(), 1);
+	center = glm::vec3(p.x, p.y, p.z);
+	for (int i = 0; i < 3; i++) {
+		glm::vec3 a(transform[i][0], transform[i][1], transform[i][2]);
+		float scale = glm::length(a);
+		axis[i] = a / scale;
+		half[i] = h[i] * scale;
+	}
+}
+
+// radius of the box projected onto axis l
+//
+static float radius(const OrientedBox& obb, const glm::vec3& l) {
+	return obb.half.x * fabs(glm::dot(l, obb.axis[0])) + obb.half.y * fabs(glm::dot(l, obb.axis[1]))
+		+ obb.half.z * fabs(glm::dot(l, obb.axis[2]));
+}
+
+Box OrientedBox::bounds() const {
+	glm::vec3 r;
+	for (int i = 0; i < 3; i++) {
+		glm::vec3 l(0);
+		l[i] = 1;
+		r[i] = radius(*this, l);
+	}
+	glm::vec3 min = center - r;
+	glm::vec3 max = center + r;
+	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+}
+
+bool OrientedBox::inside(const glm::vec3& p) const {
+	glm::vec3 d = p - center;
+	for (int i = 0; i < 3; i++) {
+		if (fabs(glm::dot(d, axis[i])) > half[i]) return false;
+	}
+	return true;
+}
+
+//  overlap with an AABB:  the 3 world axes, the 3 box axes and their 9 cross
+//  products.  Cross products of (nearly) parallel axes are skipped, the face
+//  axes already cover them.
+//
+bool OrientedBox::overlap(const Box& box) const {
+	Vector3 bc = box.center();
+	Vector3 bh = (box.max() - box.min()) * 0.5;
+	glm::vec3 boxHalf(bh.x(), bh.y(), bh.z());
+	glm::vec3 d = glm::vec3(bc.x(), bc.y(), bc.z()) - center;
+	const glm::vec3 world[3] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) };
+
+	auto separated = [&](const glm::vec3& l) {
+		float rBox = boxHalf.x * fabs(l.x) + boxHalf.y * fabs(l.y) + boxHalf.z * fabs(l.z);
+		return fabs(glm::dot(d, l)) > rBox + radius(*this, l);
+	};
+	for (int i = 0; i < 3; i++) {
+		if (separated(world[i]) || separated(axis[i])) return false;
+	}
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			glm::vec3 l = glm::cross(world[i], axis[j]);
+			if (glm::dot(l, l) > 1e-6 && separated(l)) return false;
+		}
+	}
+	return true;
+}
+
+//  overlap with triangle (a, b, c):  the 3 box axes, the triangle normal and
+//  the 9 cross products of box axes and triangle edges, as in Box::overlap()
+//
+bool OrientedBox::overlap(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) const {
+	glm::vec3 v[3] = { a - center, b - center, c - center };
+	glm::vec3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+	auto separated = [&](const glm::vec3& l) {
+		float p0 = glm::dot(l, v[0]), p1 = glm::dot(l, v[1]), p2 = glm::dot(l, v[2]);
+		float r = radius(*this, l);
+		return fmin(p0, fmin(p1, p2)) > r || fmax(p0, fmax(p1, p2)) < -r;
+	};
+	for (int i = 0; i < 3; i++) {
+		if (separated(axis[i])) return false;
+	}
+	if (separated(glm::cross(e[0], e[1]))) return false;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			if (separated(glm::cross(axis[i], e[j]))) return false;
+		}
+	}
+	return true;
+}
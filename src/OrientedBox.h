@@ -0,0 +1,24 @@
+#pragma once
+//  Oriented bounding box: a Box in some local frame, carried into world space
+//  by a transform (rotation, translation and uniform or per axis scale).
+//  Overlap tests against axis aligned boxes and triangles use the separating
+//  axis theorem.
+//
+
+#include "ofMain.h"
+#include "box.h"
+
+class OrientedBox {
+public:
+	OrientedBox() { }
+	OrientedBox(const Box& local, const glm::mat4& transform);
+
+	Box bounds() const;		// world space AABB
+	bool overlap(const Box& box) const;
+	bool overlap(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) const;
+	bool inside(const glm::vec3& p) const;
+
+	glm::vec3 center;
+	glm::vec3 axis[3];		// unit length
+	glm::vec3 half;			// half extent along each axis
+};
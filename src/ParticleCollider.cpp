@@ -0,0 +1,129 @@
+//  Particle - terrain collision - see ParticleCollider.h
+//
+
+#include "ParticleCollider.h"
+
+// spreads the low 16 bits of v to the even bits
+//
+static unsigned spreadBits(unsigned v) {
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+void ParticleCollider::sort(ParticlePool& particles, const HeightGrid& grid) {
+	makeKeys(particles, grid);
+	sortByKeys(particles);
+}
+
+// tile key of every particle, returns how many are out of order (lower than
+// the key before them)
+//
+int ParticleCollider::makeKeys(const ParticlePool& particles, const HeightGrid& grid) {
+	int n = particles.size();
+	keys.resize(n);
+	keysTmp.resize(n);
+	order.resize(n);
+	orderTmp.resize(n);
+
+	// particles outside the grid take the key after the last tile
+	int bits = 0;
+	while ((std::max(grid.cellsX - 1, grid.cellsZ - 1) >> tileShift) >> bits) bits++;
+	unsigned outside = 1u << (2 * bits);
+	int unsorted = 0;
+	for (int i = 0; i < n; i++) {
+		float fx = (particles.x[i] - grid.x0) / grid.size;
+		float fz = (particles.z[i] - grid.z0) / grid.size;
+		if (fx >= 0 && fz >= 0 && fx < grid.cellsX && fz < grid.cellsZ) {
+			keys[i] = spreadBits((unsigned)fx >> tileShift) | (spreadBits((unsigned)fz >> tileShift) << 1);
+		}
+		else keys[i] = outside;
+		order[i] = i;
+		if (i > 0 && keys[i] < keys[i - 1]) unsorted++;
+	}
+	return unsorted;
+}
+
+// LSD radix sort of the keys, a byte per pass.  A pass whose byte is the
+// same for every key is skipped, so up to 128 x 128 tiles sort in two passes
+//
+void ParticleCollider::sortByKeys(ParticlePool& particles) {
+	int n = particles.size();
+	if (n == 0) return;
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		int count[257] = { 0 };
+		for (int i = 0; i < n; i++) count[((keys[i] >> shift) & 0xff) + 1]++;
+		if (count[((keys[0] >> shift) & 0xff) + 1] == n) continue;
+		for (int b = 0; b < 256; b++) count[b + 1] += count[b];
+		for (int i = 0; i < n; i++) {
+			int to = count[(keys[i] >> shift) & 0xff]++;
+			keysTmp[to] = keys[i];
+			orderTmp[to] = order[i];
+		}
+		keys.swap(keysTmp);
+		order.swap(orderTmp);
+	}
+
+	// gather every attribute into the sorted order
+	scratch.resize(particles.capacity());
+	for (vector<float>* a : { &particles.x, &particles.y, &particles.z, &particles.dx, &particles.dy,
+		&particles.dz, &particles.speed, &particles.life }) {
+		const float* from = a->data();
+		for (int i = 0; i < n; i++) scratch[i] = from[order[i]];
+		a->swap(scratch);
+	}
+}
+
+int ParticleCollider::collide(ParticlePool& particles, const HeightGrid& grid, ThreadPool* pool) {
+	hits = 0;
+	if (grid.empty() || particles.size() == 0) return 0;
+	if (sortByCell && makeKeys(particles, grid) > maxUnsorted * particles.size()) sortByKeys(particles);
+
+	// HeightGrid::cell() and sampleHeight() in one
+	float scale = 1 / grid.size;
+	int row = grid.cellsX + 1;
+	std::atomic<int> numHits{ 0 };
+	forEachChunk(pool, particles.size(), grainSize, [&](int begin, int end) {
+		int chunkHits = 0;
+		for (int i = begin; i < end; i++) {
+			float fx = (particles.x[i] - grid.x0) * scale;
+			float fz = (particles.z[i] - grid.z0) * scale;
+			if (fx < 0 || fz < 0 || fx >= grid.cellsX || fz >= grid.cellsZ) continue;
+			int cx = (int)fx, cz = (int)fz;
+			if (particles.y[i] >= grid.maxY[cz * grid.cellsX + cx]) continue;	// above everything in the cell
+
+			float u = fx - cx, v = fz - cz;
+			const float* row0 = &grid.cornerY[cz * row + cx];
+			const float* row1 = row0 + row;
+			float ground = (row0[0] * (1 - u) + row0[1] * u) * (1 - v) + (row1[0] * (1 - u) + row1[1] * u) * v;
+			if (particles.y[i] >= ground) continue;
+
+			chunkHits++;
+			if (!bounce) {
+				particles.life[i] = -1;
+				continue;
+			}
+
+			// back onto the ground, and reflect the vertical motion of a step,
+			// dy * speed / 10 - speed (see ParticlePool::updateScalar())
+			particles.y[i] = ground;
+			float s = particles.speed[i];
+			if (s <= 0) continue;
+			float vy = particles.dy[i] * s / 10 - s;
+			if (vy < 0) {
+				particles.dy[i] = (-restitution * vy + s) * 10 / s;
+				particles.dx[i] *= friction;
+				particles.dz[i] *= friction;
+			}
+		}
+		numHits += chunkHits;
+	});
+
+	hits = numHits;
+	if (!bounce && hits > 0) particles.compact();
+	return hits;
+}
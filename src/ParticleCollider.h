@@ -0,0 +1,46 @@
+#pragma once
+//  Particle - terrain collision.
+//
+//  Once per frame every live particle is tested against the heightfield grid
+//  of the terrain (HeightGrid, built from the octree): a particle under the
+//  bilinear ground height has gone through the surface and is put back on it
+//  and bounced, or killed.  The particles are first sorted by the Morton code
+//  of their tile of grid cells, so neighbours in the pool read neighbouring
+//  cells and the chunks the stage is cut into each touch a compact patch of
+//  the grid.  The sort is applied to the pool itself and the particles move
+//  little between frames, so the pool stays close to that order and most
+//  frames can skip the sort.
+//
+
+#include "ParticlePool.h"
+#include "HeightGrid.h"
+
+class ParticleCollider {
+public:
+	// collide the particles with the grid's surface, in chunks on pool when
+	// one is given.  Dead particles are removed.  Returns the particles that
+	// hit the ground
+	int collide(ParticlePool& particles, const HeightGrid& grid, ThreadPool* pool = nullptr);
+
+	// reorder the pool by the Morton code of the particles' tiles of grid
+	// cells, particles outside the grid last
+	void sort(ParticlePool& particles, const HeightGrid& grid);
+
+	bool bounce = true;		// false kills the particles that hit
+	float restitution = 0.3;	// share of the vertical speed a bounce keeps
+	float friction = 0.7;		// share of the horizontal speed a bounce keeps
+	bool sortByCell = true;
+	float maxUnsorted = 0.05;	// share of particles out of order collide() leaves unsorted
+	int tileShift = 3;		// tiles of 2^tileShift x 2^tileShift cells
+	int grainSize = 8192;		// particles per task
+
+	int hits = 0;			// particles that hit in the last collide()
+
+private:
+	int makeKeys(const ParticlePool& particles, const HeightGrid& grid);
+	void sortByKeys(ParticlePool& particles);
+
+	vector<unsigned> keys, keysTmp;
+	vector<int> order, orderTmp;
+	vector<float> scratch;
+};
@@ -0,0 +1,109 @@
+//  Structure of arrays particle pool - see ParticlePool.h
+//
+
+#include "ParticlePool.h"
+
+#if !defined(SPACELANDER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PARTICLES_SSE
+#include <emmintrin.h>
+#endif
+
+void ParticlePool::reserve(int capacity) {
+	for (vector<float>* a : { &x, &y, &z, &dx, &dy, &dz, &speed, &life }) {
+		a->assign(capacity, 0);
+	}
+	count = 0;
+}
+
+int ParticlePool::emit(float px, float py, float pz, float lifespan, float s, const glm::vec3& direction) {
+	int n = 1;
+	int i = claim(n);
+	if (n == 0) return -1;
+	set(i, px, py, pz, lifespan, s, direction);
+	return i;
+}
+
+int ParticlePool::claim(int& n) {
+	int room = capacity() - count;
+	if (n > room) {
+		dropped += n - room;
+		n = room;
+	}
+	int first = count;
+	count += n;
+	return first;
+}
+
+void ParticlePool::set(int i, float px, float py, float pz, float lifespan, float s, const glm::vec3& direction) {
+	x[i] = px;
+	y[i] = py;
+	z[i] = pz;
+	dx[i] = direction.x;
+	dy[i] = direction.y;
+	dz[i] = direction.z;
+	speed[i] = s;
+	life[i] = lifespan;
+}
+
+// Particle::update(): position += direction * speed / 10, then the particle
+// sinks by speed and loses one step of life
+//
+void ParticlePool::updateScalar(int begin, int end) {
+	for (int i = begin; i < end; i++) {
+		x[i] += dx[i] * speed[i] / 10;
+		y[i] += dy[i] * speed[i] / 10;
+		z[i] += dz[i] * speed[i] / 10;
+		y[i] -= speed[i];
+		life[i] -= 1.0f;
+	}
+}
+
+void ParticlePool::step(int begin, int end) {
+	int i = begin;
+#if defined(PARTICLES_SSE)
+	// same operations in the same order as the scalar loop
+	const __m128 ten = _mm_set1_ps(10.0f), one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= end; i += 4) {
+		__m128 sp = _mm_loadu_ps(&speed[i]);
+		__m128 mx = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&dx[i]), sp), ten);
+		__m128 my = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&dy[i]), sp), ten);
+		__m128 mz = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&dz[i]), sp), ten);
+		_mm_storeu_ps(&x[i], _mm_add_ps(_mm_loadu_ps(&x[i]), mx));
+		_mm_storeu_ps(&y[i], _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&y[i]), my), sp));
+		_mm_storeu_ps(&z[i], _mm_add_ps(_mm_loadu_ps(&z[i]), mz));
+		_mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), one));
+	}
+#endif
+	updateScalar(i, end);
+}
+
+// every particle is stepped on its own, so the chunks need no locks and the
+// result does not depend on how they were scheduled
+//
+void ParticlePool::update(ThreadPool* pool) {
+	forEachChunk(pool, count, grainSize, [this](int begin, int end) { step(begin, end); });
+	compact();
+}
+
+// replace particle i by the last one
+//
+void ParticlePool::kill(int i) {
+	int last = --count;
+	x[i] = x[last];
+	y[i] = y[last];
+	z[i] = z[last];
+	dx[i] = dx[last];
+	dy[i] = dy[last];
+	dz[i] = dz[last];
+	speed[i] = speed[last];
+	life[i] = life[last];
+}
+
+int ParticlePool::compact() {
+	int before = count;
+	for (int i = 0; i < count;) {
+		if (life[i] < 0) kill(i);	// the moved particle is checked next
+		else i++;
+	}
+	return before - count;
+}
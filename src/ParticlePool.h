@@ -0,0 +1,58 @@
+#pragma once
+//  Fixed capacity particle pool in structure of arrays form.
+//
+//  Every attribute of Particle (ParticleCustom.h) lives in an array of its
+//  own, so update() streams through them four particles at a time (SSE, or
+//  a scalar loop on other CPUs or when SPACELANDER_NO_SIMD is defined) and
+//  does exactly what Particle::update() does.  A dead particle is replaced by
+//  the last live one, so removal is O(1) and the live particles stay packed
+//  in [0, size()).  The order of the particles is not kept.
+//
+//  With a thread pool, update() steps chunks of grainSize particles as
+//  parallel tasks; only the removal of the dead ones stays serial.  Parallel
+//  emitters claim() a range of slots first and then set() them from as many
+//  tasks as they like.
+//
+
+#include "ofMain.h"
+#include "ThreadPool.h"
+
+class ParticlePool {
+public:
+	ParticlePool(int capacity = 1 << 17) { reserve(capacity); }
+	void reserve(int capacity);	// drops the particles
+	void clear() { count = 0; }
+
+	// same arguments as the Particle constructor.  Returns the new index, -1
+	// when the pool is full
+	int emit(float x, float y, float z, float lifespan, float speed, const glm::vec3& direction);
+
+	// n new particles at the end, returns the first.  n is cut to the room
+	// left; their slots hold garbage until set()
+	int claim(int& n);
+	void set(int i, float x, float y, float z, float lifespan, float speed, const glm::vec3& direction);
+
+	// advance every particle one step, then remove the dead ones.  pool =
+	// nullptr runs on the calling thread
+	void update(ThreadPool* pool = nullptr);
+	void step(int begin, int end);	// advance [begin, end) one step
+	void updateScalar(int begin, int end);
+	void kill(int i);
+	int compact();			// removes dead particles, returns how many
+
+	int size() const { return count; }
+	int capacity() const { return (int)x.size(); }
+	glm::vec3 position(int i) const { return glm::vec3(x[i], y[i], z[i]); }
+	bool isDead(int i) const { return life[i] < 0; }
+
+	vector<float> x, y, z;		// position
+	vector<float> dx, dy, dz;	// direction
+	vector<float> speed;
+	vector<float> life;		// steps left
+
+	int dropped = 0;		// emits refused because the pool was full
+	int grainSize = 16384;		// particles per update task
+
+private:
+	int count = 0;
+};
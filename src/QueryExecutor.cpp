@@ -0,0 +1,75 @@
+//  Parallel batches of octree queries - see QueryExecutor.h
+//
+
+#include "QueryExecutor.h"
+
+template <class Fn>
+void QueryExecutor::forEachChunk(int count, Fn fn) const {
+	::forEachChunk(pool, count, grainSize, fn);
+}
+
+int QueryExecutor::intersect(const vector<Ray>& rays, vector<RayHit>& hits, float tMax) {
+	hits.resize(rays.size());
+	if (octree->bLazy) return octree->intersect(rays.data(), rays.size(), hits.data(), tMax);
+
+	const Octree& tree = *octree;
+	std::atomic<int> numHits{ 0 };
+	forEachChunk(rays.size(), [&](int begin, int end) {
+		numHits += tree.intersect(rays.data() + begin, end - begin, hits.data() + begin, tMax);
+	});
+	return numHits;
+}
+
+int QueryExecutor::intersect(const vector<Box>& boxes, vector<QueryContext>& results) {
+	results.resize(boxes.size());
+	if (octree->bLazy) {
+		int n = 0;
+		for (int i = 0; i < boxes.size(); i++) {
+			if (octree->intersect(boxes[i], results[i])) n++;
+		}
+		return n;
+	}
+
+	const Octree& tree = *octree;
+	std::atomic<int> numHits{ 0 };
+	forEachChunk(boxes.size(), [&](int begin, int end) {
+		int n = 0;
+		for (int i = begin; i < end; i++) {
+			if (tree.intersect(boxes[i], results[i])) n++;
+		}
+		numHits += n;
+	});
+	return numHits;
+}
+
+int QueryExecutor::overlapAny(const vector<OrientedBox>& boxes, int& faceRtn) {
+	if (octree->bLazy) {
+		for (int i = 0; i < boxes.size(); i++) {
+			if (octree->overlap(boxes[i], faceRtn)) return i;
+		}
+		return -1;
+	}
+
+	const Octree& tree = *octree;
+	std::atomic<bool> found{ false };
+	std::atomic<int> hitBox{ -1 }, hitFace{ -1 };
+	auto test = [&](int i) {
+		int face;
+		if (tree.overlap(boxes[i], face, &found) && !found.exchange(true)) {
+			hitFace = face;
+			hitBox = i;
+		}
+	};
+	if (!pool) {
+		for (int i = 0; i < boxes.size() && !found; i++) test(i);
+	}
+	else {
+		TaskGroup group;
+		for (int i = 0; i < boxes.size(); i++) {
+			pool->run(group, [&test, i] { test(i); });
+		}
+		pool->wait(group);
+	}
+	if (hitBox >= 0) faceRtn = hitFace;
+	return hitBox;
+}
@@ -0,0 +1,44 @@
+#pragma once
+//  Parallel batches of octree queries.
+//
+//  A batch is cut into chunks of grainSize queries and every chunk runs as a
+//  task on the pool.  The tasks only call the const queries of the octree and
+//  each one writes its own slice of the results, so nothing is locked.  The
+//  tree must not be modified (rebuilt, or expanded by a lazy query on another
+//  thread) while a batch runs.  A lazy tree (bLazy) grows as it is queried,
+//  so its batches run on the calling thread through the lazy queries, which
+//  subdivide only the nodes the batch reaches.  Only the linear layout
+//  (bFlatLayout) is supported.
+//
+
+#include "Octree.h"
+#include "ThreadPool.h"
+
+class QueryExecutor {
+public:
+	// pool = nullptr runs every batch on the calling thread
+	QueryExecutor() {}
+	QueryExecutor(Octree& octree, ThreadPool* pool = nullptr) : octree(&octree), pool(pool) {}
+
+	// closest hit of every ray, each chunk traversed as packets (linear layout).
+	// Returns the number of rays that hit
+	int intersect(const vector<Ray>& rays, vector<RayHit>& hits, float tMax = 10000.0);
+
+	// leaf boxes and points overlapping each box.  results is resized to the
+	// batch and its contexts are reused, so a steady stream of batches does
+	// not reallocate them.  Returns the number of boxes that hit
+	int intersect(const vector<Box>& boxes, vector<QueryContext>& results);
+
+	// index of an oriented box that touches the terrain, -1 if none does.
+	// Every box is a task of its own and all of them stop as soon as one
+	// finds a contact; faceRtn is the triangle it touches
+	int overlapAny(const vector<OrientedBox>& boxes, int& faceRtn);
+
+	int grainSize = 256;	// queries per task
+
+private:
+	template <class Fn> void forEachChunk(int count, Fn fn) const;
+
+	Octree* octree = nullptr;
+	ThreadPool* pool = nullptr;
+};
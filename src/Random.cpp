@@ -0,0 +1,77 @@
+//  Small, fast, seedable random number generator - see Random.h
+//
+
+#include "Random.h"
+
+#if !defined(SPACELANDER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RANDOM_SSE
+#include <emmintrin.h>
+#endif
+
+// four generators for a bulk fill, each on a stream of its own under a seed
+// drawn from this one
+//
+void Rng::seedLanes(Rng lanes[4]) {
+	uint64_t seed = ((uint64_t)next() << 32) | next();
+	for (int l = 0; l < 4; l++) {
+		lanes[l].seed(seed, l);
+	}
+}
+
+// number k of lane l goes to out[4 * k + l]
+//
+void Rng::fillScalar(float* out, int n, float a, float b) {
+	Rng lanes[4];
+	seedLanes(lanes);
+	for (int i = 0; i < n; i++) {
+		out[i] = range(toUnit(lanes[i & 3].next()), a, b);
+	}
+}
+
+#if defined(RANDOM_SSE)
+static inline __m128i rotl4(__m128i x, int k) {
+	return _mm_or_si128(_mm_slli_epi32(x, k), _mm_srli_epi32(x, 32 - k));
+}
+#endif
+
+void Rng::fill(float* out, int n, float a, float b) {
+#if defined(RANDOM_SSE)
+	Rng lanes[4];
+	seedLanes(lanes);
+
+	// the state words of the four lanes side by side; * 5 and * 9 are a
+	// shift and an add, which SSE2 has for 32 bit lanes
+	__m128i s0 = _mm_setr_epi32(lanes[0].s[0], lanes[1].s[0], lanes[2].s[0], lanes[3].s[0]);
+	__m128i s1 = _mm_setr_epi32(lanes[0].s[1], lanes[1].s[1], lanes[2].s[1], lanes[3].s[1]);
+	__m128i s2 = _mm_setr_epi32(lanes[0].s[2], lanes[1].s[2], lanes[2].s[2], lanes[3].s[2]);
+	__m128i s3 = _mm_setr_epi32(lanes[0].s[3], lanes[1].s[3], lanes[2].s[3], lanes[3].s[3]);
+	const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+	const __m128 base = _mm_set1_ps(a), width = _mm_set1_ps(b - a);
+
+	int i = 0;
+	for (; i < n; i += 4) {
+		__m128i x5 = _mm_add_epi32(_mm_slli_epi32(s1, 2), s1);
+		__m128i r = rotl4(x5, 7);
+		__m128i result = _mm_add_epi32(_mm_slli_epi32(r, 3), r);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = rotl4(s3, 11);
+
+		// same operations as toUnit() and range()
+		__m128 u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale);
+		__m128 v = _mm_add_ps(base, _mm_mul_ps(width, u));
+		if (i + 4 <= n) _mm_storeu_ps(out + i, v);
+		else {
+			float tail[4];
+			_mm_storeu_ps(tail, v);
+			for (int j = i; j < n; j++) out[j] = tail[j - i];
+		}
+	}
+#else
+	fillScalar(out, n, a, b);
+#endif
+}
@@ -0,0 +1,84 @@
+#pragma once
+//  Small, fast, seedable random number generator for the game's random
+//  systems: particle emitters, the explosion response and the landing areas.
+//
+//  xoshiro128** (Blackman & Vigna): 16 bytes of state and a few shifts and
+//  multiplies per number, where ofRandom() goes through rand() and its one
+//  hidden, shared state.  Rng(seed, stream) scrambles both into the state with
+//  splitmix64, so every (seed, stream) pair is a sequence of its own: every
+//  system draws from its own streams (rngStream()), parallel jobs each take
+//  their own stream instead of sharing a generator, and what a job draws
+//  depends on its stream, not on the thread it runs on.  The same seed gives
+//  the same landing areas, explosions and particles.
+//
+//  fill() draws many numbers at once: four generators seeded from this one
+//  run side by side, in SSE2 registers where the CPU has them (and
+//  SPACELANDER_NO_SIMD is not defined).  fillScalar() computes the same
+//  numbers one lane at a time.
+//
+
+#include <cstdint>
+
+// the random systems, each with its own streams
+//
+enum RngSystem : uint64_t {
+	RngParticles = 1,	// stream per particle step and emitter chunk
+	RngExplosion = 2,
+	RngLanding = 3,		// stream per terrain (Octree::landingStream)
+};
+
+inline uint64_t rngStream(RngSystem system, uint64_t index = 0) {
+	return ((uint64_t)system << 48) ^ index;
+}
+
+class Rng {
+public:
+	Rng(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+	void seed(uint64_t seed, uint64_t stream = 0) {
+		uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+		uint64_t a = splitmix64(x), b = splitmix64(x);
+		s[0] = (uint32_t)a;
+		s[1] = (uint32_t)(a >> 32);
+		s[2] = (uint32_t)b;
+		s[3] = (uint32_t)(b >> 32);
+		if ((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;	// the one state that never leaves 0
+	}
+
+	uint32_t next() {
+		uint32_t result = rotl(s[1] * 5, 7) * 9;
+		uint32_t t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+		return result;
+	}
+
+	// [0, 1), from the top 24 bits
+	float uniform() { return toUnit(next()); }
+
+	// [a, b) - the same arguments as ofRandom(a, b)
+	float uniform(float a, float b) { return range(uniform(), a, b); }
+
+	// n numbers in [a, b).  Advances this generator by two numbers, whatever n
+	void fill(float* out, int n, float a = 0, float b = 1);
+	void fillScalar(float* out, int n, float a = 0, float b = 1);
+
+	static float toUnit(uint32_t x) { return (x >> 8) * (1.0f / 16777216.0f); }
+	static float range(float u, float a, float b) { return a + (b - a) * u; }	// [0, 1) to [a, b)
+
+private:
+	static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+	static uint64_t splitmix64(uint64_t& x) {
+		uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	void seedLanes(Rng lanes[4]);
+
+	uint32_t s[4];
+};
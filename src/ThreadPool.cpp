@@ -0,0 +1,138 @@
+//  Small work stealing thread pool - see ThreadPool.h
+//
+
+#include "ThreadPool.h"
+
+// identifies the pool and the deque of the worker running on this thread
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+// group of the task running on this thread, parent of the groups it submits to
+static thread_local const TaskGroup* currentGroup = nullptr;
+
+// this group or one nested under it by its tasks
+//
+bool TaskGroup::isWithin(const TaskGroup* group) const {
+	for (const TaskGroup* g = this; g; g = g->parent) {
+		if (g == group) return true;
+	}
+	return false;
+}
+
+int ThreadPool::hardwareThreads() {
+	int n = std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+ThreadPool::ThreadPool(int numThreads) {
+	if (numThreads <= 0) {
+		numThreads = (hardwareThreads() > 1) ? hardwareThreads() - 1 : 1;
+	}
+	for (int i = 0; i <= numThreads; i++) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	}
+	for (int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		stop = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// deque owned by the calling thread - outside threads share the last one
+//
+int ThreadPool::self() const {
+	return (currentPool == this) ? currentWorker : workers.size();
+}
+
+void ThreadPool::run(TaskGroup& group, std::function<void()> task) {
+	group.pending++;
+	group.parent = currentGroup;
+	Queue& queue = *queues[self()];
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.tasks.push_back({ std::move(task), &group });
+	}
+	queued++;
+	{
+		// taking the lock orders the notify after a sleeper's predicate check
+		std::lock_guard<std::mutex> lock(sleepLock);
+	}
+	wake.notify_one();
+}
+
+//  pop:  newest task of our own deque first, otherwise steal the oldest
+//        task of another deque.  With within set, only tasks of that group
+//        or of groups nested under it
+//
+bool ThreadPool::pop(int self, Task& task, const TaskGroup* within) {
+	{
+		Queue& queue = *queues[self];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (take(queue.tasks, true, task, within)) return true;
+	}
+	int n = queues.size();
+	for (int i = 1; i < n; i++) {
+		Queue& victim = *queues[(self + i) % n];
+		std::lock_guard<std::mutex> lock(victim.lock);
+		if (take(victim.tasks, false, task, within)) return true;
+	}
+	return false;
+}
+
+// first matching task from the back (newest) or front (oldest) of a locked deque
+//
+bool ThreadPool::take(std::deque<Task>& tasks, bool newest, Task& task, const TaskGroup* within) {
+	int n = tasks.size();
+	for (int i = 0; i < n; i++) {
+		int k = newest ? n - 1 - i : i;
+		if (within && !tasks[k].group->isWithin(within)) continue;
+		task = std::move(tasks[k]);
+		tasks.erase(tasks.begin() + k);
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::execute(Task& task) {
+	const TaskGroup* outer = currentGroup;
+	currentGroup = task.group;
+	task.fn();
+	currentGroup = outer;
+	task.group->pending--;
+}
+
+// help out with queued tasks of the group until every one of them has finished
+//
+void ThreadPool::wait(TaskGroup& group) {
+	int me = self();
+	while (group.pending > 0) {
+		Task task;
+		if (pop(me, task, &group)) execute(task);
+		else std::this_thread::yield();
+	}
+}
+
+void ThreadPool::workerLoop(int self) {
+	currentPool = this;
+	currentWorker = self;
+	while (true) {
+		Task task;
+		if (pop(self, task)) {
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepLock);
+		wake.wait(lock, [this] { return stop || queued > 0; });
+		if (stop && queued == 0) return;
+	}
+}
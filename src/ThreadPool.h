@@ -0,0 +1,86 @@
+#pragma once
+//  Small work stealing thread pool.
+//
+//  Every worker owns a task deque: it pushes and pops its own tasks at the
+//  back and steals from the front of the other workers' deques when it runs
+//  dry.  wait() runs queued tasks of the group it waits on, and of the groups
+//  nested under it, while it waits, so a task may itself spawn sub tasks and
+//  wait on them without starving the pool.  It never picks up unrelated work:
+//  a terrain build waiting on its subtrees does not run another terrain's
+//  whole build inside that wait.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// counts the unfinished tasks submitted under it
+//
+class TaskGroup {
+public:
+	std::atomic<int> pending{ 0 };
+	const TaskGroup* parent = nullptr;	// group of the task that submitted to it, if any
+
+	bool isWithin(const TaskGroup* group) const;
+};
+
+class ThreadPool {
+public:
+	// numThreads = number of worker threads, 0 = one per core minus the caller
+	ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	void run(TaskGroup& group, std::function<void()> task);
+	void wait(TaskGroup& group);
+	int size() const { return workers.size(); }
+
+	static int hardwareThreads();
+
+private:
+	struct Task {
+		std::function<void()> fn;
+		TaskGroup* group = nullptr;
+	};
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	int self() const;
+	bool pop(int self, Task& task, const TaskGroup* within = nullptr);
+	bool take(std::deque<Task>& tasks, bool newest, Task& task, const TaskGroup* within);
+	void execute(Task& task);
+	void workerLoop(int self);
+
+	std::vector<std::unique_ptr<Queue>> queues;	// one per worker, the last one for outside threads
+	std::vector<std::thread> workers;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::atomic<int> queued{ 0 };
+	bool stop = false;
+};
+
+// fn(begin, end) for every chunk of grainSize items of [0, count), as tasks
+// on the pool when there is one and more than one chunk, otherwise in order
+// on the calling thread.  The chunks are the same either way
+//
+template <class Fn>
+void forEachChunk(ThreadPool* pool, int count, int grainSize, Fn fn) {
+	if (!pool || count <= grainSize) {
+		for (int begin = 0; begin < count; begin += grainSize) {
+			fn(begin, (begin + grainSize < count) ? begin + grainSize : count);
+		}
+		return;
+	}
+	TaskGroup group;
+	for (int begin = 0; begin < count; begin += grainSize) {
+		int end = (begin + grainSize < count) ? begin + grainSize : count;
+		pool->run(group, [&fn, begin, end] { fn(begin, end); });
+	}
+	pool->wait(group);
+}
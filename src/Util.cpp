@@ -35,4 +35,34 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, const ofV
 //
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &n) {
 	return (v - 2 * v.dot(n) * n);
-}
\ No newline at end of file
+}
+
+//---------------------------------------------------------------
+// test if a ray intersects a triangle (Moller-Trumbore).  If there is an
+// intersection in front of the ray, return true and put the distance along
+// raydir in "t"
+//
+bool rayIntersectTriangle(const glm::vec3 &rayPoint, const glm::vec3 &raydir, const glm::vec3 &v0,
+	const glm::vec3 &v1, const glm::vec3 &v2, float &t)
+{
+	const float eps = .0000001;
+	glm::vec3 e1 = v1 - v0;
+	glm::vec3 e2 = v2 - v0;
+	glm::vec3 p = glm::cross(raydir, e2);
+	float det = glm::dot(e1, p);
+
+	// ray is parallel to the triangle
+	if (abs(det) < eps) return false;
+
+	float invDet = 1.0 / det;
+	glm::vec3 s = rayPoint - v0;
+	float u = glm::dot(s, p) * invDet;
+	if (u < 0 || u > 1) return false;
+
+	glm::vec3 q = glm::cross(s, e1);
+	float v = glm::dot(raydir, q) * invDet;
+	if (v < 0 || u + v > 1) return false;
+
+	t = glm::dot(e2, q) * invDet;
+	return t >= 0;
+}
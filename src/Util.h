@@ -8,5 +8,8 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, ofVec3f c
 
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &normal);
 
+bool rayIntersectTriangle(const glm::vec3 &rayPoint, const glm::vec3 &raydir, const glm::vec3 &v0,
+	const glm::vec3 &v1, const glm::vec3 &v2, float &t);
+
 
 
@@ -13,6 +13,11 @@
  */
 
 bool Box::intersect(const Ray &r, float t0, float t1) const {
+  float tEnter;
+  return intersect(r, t0, t1, tEnter);
+}
+
+bool Box::intersect(const Ray &r, float t0, float t1, float &tEnter) const {
   float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
   tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
@@ -33,5 +38,127 @@ bool Box::intersect(const Ray &r, float t0, float t1) const {
     tmin = tzmin;
   if (tzmax < tmax)
     tmax = tzmax;
+  tEnter = (tmin > t0) ? tmin : t0;
   return ( (tmin < t1) && (tmax > t0) );
 }
+
+/*
+ * Triangle-box overlap test using the separating axis theorem, as described
+ * in:
+ *
+ *      Tomas Akenine-Moller
+ *      "Fast 3D Triangle-Box Overlap Testing"
+ *      Journal of graphics tools, 6(1):29-33, 2001
+ *
+ * Tests the 3 box face normals, the triangle normal and the 9 cross products
+ * of box and triangle edges.
+ */
+
+bool Box::overlap(const Vector3 &a, const Vector3 &b, const Vector3 &c) const {
+  Vector3 center = (parameters[0] + parameters[1]) * 0.5;
+  Vector3 half = (parameters[1] - parameters[0]) * 0.5;
+  Vector3 v[3] = { a - center, b - center, c - center };
+
+  // box face normals
+  for (int i = 0; i < 3; i++) {
+    float mn = fminf(v[0][i], fminf(v[1][i], v[2][i]));
+    float mx = fmaxf(v[0][i], fmaxf(v[1][i], v[2][i]));
+    if (mn > half[i] || mx < -half[i])
+      return false;
+  }
+
+  // triangle normal
+  Vector3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+  Vector3 n = e[0] ^ e[1];
+  float r = half.x() * fabsf(n.x()) + half.y() * fabsf(n.y()) + half.z() * fabsf(n.z());
+  if (fabsf(n * v[0]) > r)
+    return false;
+
+  // cross products of the box axes and the triangle edges
+  const Vector3 axes[3] = { Vector3(1, 0, 0), Vector3(0, 1, 0), Vector3(0, 0, 1) };
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      Vector3 axis = axes[i] ^ e[j];
+      float p0 = axis * v[0], p1 = axis * v[1], p2 = axis * v[2];
+      float mn = fminf(p0, fminf(p1, p2));
+      float mx = fmaxf(p0, fmaxf(p1, p2));
+      r = half.x() * fabsf(axis.x()) + half.y() * fabsf(axis.y()) + half.z() * fabsf(axis.z());
+      if (mn > r || mx < -r)
+        return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Swept box tests.  Along any axis the projections of the moving box and the
+ * other shape overlap during one interval of t, and the shapes touch while
+ * all of those intervals do (separating axis theorem), so the first contact
+ * is the latest interval start over the axes, as long as no interval ends
+ * before it.
+ */
+
+// narrow [tFirst, tLast] to the t where [lo, hi] + t * speed overlaps [mn, mx]
+static bool sweepAxis(float lo, float hi, float speed, float mn, float mx, float &tFirst, float &tLast) {
+  if (speed == 0)
+    return (hi >= mn && lo <= mx);
+  float ta = (mn - hi) / speed;
+  float tb = (mx - lo) / speed;
+  if (ta > tb) {
+    float tmp = ta; ta = tb; tb = tmp;
+  }
+  tFirst = fmaxf(tFirst, ta);
+  tLast = fminf(tLast, tb);
+  return tFirst <= tLast;
+}
+
+bool Box::sweep(const Vector3 &motion, const Box &box, float t1, float &tEnter) const {
+  float tFirst = 0, tLast = t1;
+  for (int i = 0; i < 3; i++) {
+    if (!sweepAxis(parameters[0][i], parameters[1][i], motion[i], box.parameters[0][i], box.parameters[1][i], tFirst, tLast))
+      return false;
+  }
+  tEnter = tFirst;
+  return tFirst < t1;
+}
+
+// the 13 axes of overlap() above, with the triangle relative to the box center
+bool Box::sweep(const Vector3 &motion, const Vector3 &a, const Vector3 &b, const Vector3 &c,
+  float t1, float &tEnter) const {
+  Vector3 center = (parameters[0] + parameters[1]) * 0.5;
+  Vector3 half = (parameters[1] - parameters[0]) * 0.5;
+  Vector3 v[3] = { a - center, b - center, c - center };
+  float tFirst = 0, tLast = t1;
+
+  // box face normals
+  for (int i = 0; i < 3; i++) {
+    float mn = fminf(v[0][i], fminf(v[1][i], v[2][i]));
+    float mx = fmaxf(v[0][i], fmaxf(v[1][i], v[2][i]));
+    if (!sweepAxis(-half[i], half[i], motion[i], mn, mx, tFirst, tLast))
+      return false;
+  }
+
+  // triangle normal
+  Vector3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+  Vector3 n = e[0] ^ e[1];
+  float r = half.x() * fabsf(n.x()) + half.y() * fabsf(n.y()) + half.z() * fabsf(n.z());
+  float p = n * v[0];
+  if (!sweepAxis(-r, r, n * motion, p, p, tFirst, tLast))
+    return false;
+
+  // cross products of the box axes and the triangle edges
+  const Vector3 axes[3] = { Vector3(1, 0, 0), Vector3(0, 1, 0), Vector3(0, 0, 1) };
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      Vector3 axis = axes[i] ^ e[j];
+      float p0 = axis * v[0], p1 = axis * v[1], p2 = axis * v[2];
+      float mn = fminf(p0, fminf(p1, p2));
+      float mx = fmaxf(p0, fmaxf(p1, p2));
+      r = half.x() * fabsf(axis.x()) + half.y() * fabsf(axis.y()) + half.z() * fabsf(axis.z());
+      if (!sweepAxis(-r, r, axis * motion, mn, mx, tFirst, tLast))
+        return false;
+    }
+  }
+  tEnter = tFirst;
+  return tFirst < t1;
+}
@@ -25,29 +25,29 @@ class Box {
     }
     // (t0, t1) is the interval for valid hits
     bool intersect(const Ray &, float t0, float t1) const;
+    // same test, also returns where the ray enters the box (clamped to t0)
+    bool intersect(const Ray &, float t0, float t1, float &tEnter) const;
 
     // corners
     Vector3 parameters[2];
 
-	Vector3 min() { return parameters[0]; }
-	Vector3 max() { return parameters[1]; }
-	const bool inside(const Vector3 &p) {
+	Vector3 min() const { return parameters[0]; }
+	Vector3 max() const { return parameters[1]; }
+	bool inside(const Vector3 &p) const {
 		return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
 		     	(p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
 			    (p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
 	}
-	const bool inside(Vector3 *points, int size) {
-		bool allInside = true;
+	bool inside(const Vector3 *points, int size) const {
 		for (int i = 0; i < size; i++) {
-			if (!inside(points[i])) allInside = false;
-			break;
+			if (!inside(points[i])) return false;
 		}
-		return allInside;
+		return true;
 	}
 
 	// implement for Homework Project
 	//
-	bool overlap(const Box &box) {
+	bool overlap(const Box &box) const {
 		 if (parameters[0].x() > box.parameters[1].x() || parameters[1].x() < box.parameters[0].x())
 			 return false;  // No overlap in the x-axis
 		 if (parameters[0].y() > box.parameters[1].y() || parameters[1].y() < box.parameters[0].y())
@@ -57,7 +57,17 @@ class Box {
 		 return true;  // Overlaps in all three axes
 	}
 
-	Vector3 center() {
+	// triangle (a, b, c) overlaps the box - see box.cc
+	bool overlap(const Vector3 &a, const Vector3 &b, const Vector3 &c) const;
+
+	// swept tests: the box moves by motion * t for t in [0, t1).  On a hit
+	// tEnter is the first t at which it touches box / triangle (a, b, c), 0
+	// when they already overlap at the start - see box.cc
+	bool sweep(const Vector3 &motion, const Box &box, float t1, float &tEnter) const;
+	bool sweep(const Vector3 &motion, const Vector3 &a, const Vector3 &b, const Vector3 &c,
+		float t1, float &tEnter) const;
+
+	Vector3 center() const {
 		return ((max() - min()) / 2 + min());
 	}
 };
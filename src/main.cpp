@@ -2,12 +2,18 @@
 #include "ofApp.h"
 
 //========================================================================
-int main() {
+int main(int argc, char* argv[]) {
 	ofSetupOpenGL(1280, 1024, OF_WINDOW);			// <-------- setup the GL context
 
+	// --benchmark: run the benchmarks and their checks after setup, then exit
+	ofApp* app = new ofApp();
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--benchmark") app->bRunBenchmarks = true;
+	}
+
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(app);
 
 }
@@ -11,6 +11,8 @@
 
 #include "ofApp.h"
 #include "Util.h"
+#include "Benchmark.h"
+#include "AllocCounter.h"
 
 
 //--------------------------------------------------------------
@@ -80,18 +82,59 @@ void ofApp::setup() {
 	moon.setScaleNormalization(false);
 	mud.setScaleNormalization(false);
 
-	//  Create Octree for terrain
-	octreeMars.create(mars.getMesh(0), 20);
+	//  Create Octree for terrain - the three terrains are built concurrently
+	//  and each build fans its top levels out onto the same pool
+	pool.reset(new ThreadPool(numThreads));
+	octreeMars.bFlatLayout = true;
+	octreeMoon.bFlatLayout = true;
+	octreeMud.bFlatLayout = true;
+	if (seed == 0) seed = ofGetSystemTimeMicros();
+	cout << "seed " << seed << endl;
+	explosionRng.seed(seed, rngStream(RngExplosion));
+	octreeMars.seed = seed;
+	octreeMoon.seed = seed;
+	octreeMud.seed = seed;
+	octreeMars.landingStream = 0;
+	octreeMoon.landingStream = 1;
+	octreeMud.landingStream = 2;
+	octreeMars.pool = pool.get();
+	octreeMoon.pool = pool.get();
+	octreeMud.pool = pool.get();
+	octreeMars.bLazy = bLazyOctree;
+	octreeMoon.bLazy = bLazyOctree;
+	octreeMud.bLazy = bLazyOctree;
+
+	// later runs load the trees from bin/data/cache instead of rebuilding them,
+	// as long as the model files keep their size and modification time
+	ofDirectory::createDirectory("cache", true, true);
+	octreeMars.cachePath = ofToDataPath("cache/mars.octree", true);
+	octreeMoon.cachePath = ofToDataPath("cache/moon.octree", true);
+	octreeMud.cachePath = ofToDataPath("cache/mudLand.octree", true);
+	octreeMars.sourcePath = ofToDataPath("geo/mars-low-5x-v2.obj", true);
+	octreeMoon.sourcePath = ofToDataPath("geo/moon-houdini.obj", true);
+	octreeMud.sourcePath = ofToDataPath("geo/customTerrain/mudLand.obj", true);
+
+	TaskGroup terrains;
+	pool->run(terrains, [this] { octreeMars.create(mars.getMesh(0), 20); });
+	pool->run(terrains, [this] { octreeMoon.create(moon.getMesh(0), 20); });
+	pool->run(terrains, [this] { octreeMud.create(mud.getMesh(0), 20); });
+	pool->wait(terrains);
+
+	// 2D grids for the altitude sensor, each reads only its own terrain
+	pool->run(terrains, [this] { gridMars.build(octreeMars); });
+	pool->run(terrains, [this] { gridMoon.build(octreeMoon); });
+	pool->run(terrains, [this] { gridMud.build(octreeMud); });
+	pool->wait(terrains);
 	cout << "Mars # of Verts: " << mars.getMesh(0).getNumVertices() << endl;
-	octreeMoon.create(moon.getMesh(0), 20);
 	cout << "Moon # of Verts: " << moon.getMesh(0).getNumVertices() << endl;
-	octreeMud.create(mud.getMesh(0), 20);
 	cout << "Mudland # of Verts: " << mud.getMesh(0).getNumVertices() << endl;
 	currentNumLevels = 1;  // Set the default number of levels
 
 	// current terrain
-	terrain = mud;
-	octree = octreeMud;
+	terrain = &mud;
+	octree = &octreeMud;
+	partQuery = QueryExecutor(*octree, pool.get());
+	heightGrid = &gridMud;
 	gravity = 9.81;
 	acceleration = glm::vec3(0, -gravity, 0);
 
@@ -114,6 +157,7 @@ void ofApp::setup() {
 	}
 
 	bounceFactor = 100;
+	colQuery.reserve(256); // lander collision results, grows to its high water mark if needed
 
 	// sounds
 	thrustSound.load("sounds/lander_thrust.mp3");
@@ -128,12 +172,22 @@ void ofApp::setup() {
 
 	gui.add(muteSound.set("Mute Sound", false));
 	gui.add(displayAltitude.set("Display Altitude Line", false));
+	gui.add(continuousCollision.set("Continuous Collision", true));
+	gui.add(partCollision.set("Per Part Collision", true));
+	gui.add(gridAltitude.set("Heightfield Altitude", true));
+	gui.add(physicsRate.setup("Physics Rate (Hz)", 60, 30, 240));
+	gui.add(uncappedFrameRate.set("Uncapped Frame Rate", false));
+	gui.add(batchParticles.set("Batched Particles", true));
+	gui.add(parallelParticles.set("Parallel Particles", true));
+	gui.add(particleCollision.set("Particle Collision", true));
+	gui.add(particlesBounce.set("Particles Bounce", true));
 	gui.add(fuelUsed.setup("Fuel: " + to_string((fuelTime - (fuelUse / 10)) / 100.0) + " sec"));
 	gui.add(hardnessScale.setup("Crashing Threshold", gravity, 0.0, gravity * 2.0));
 
 	marsMap.addListener(this, &ofApp::switchMars);
 	moonMap.addListener(this, &ofApp::switchMoon);
 	mudMap.addListener(this, &ofApp::switchMud);
+	uncappedFrameRate.addListener(this, &ofApp::setUncapped);
 	mapOptions.setName("Terrain Maps");
 	mapOptions.add(marsMap.set("Mars", false));
 	mapOptions.add(moonMap.set("Moon", false));
@@ -153,13 +207,17 @@ void ofApp::setup() {
 
 	// Background
 	backgroundImage.load("stars.jpg");
+
+	if (bRunBenchmarks) {
+		int failures = runBenchmarks({ { "Mars", mars.getMesh(0) }, { "Moon", moon.getMesh(0) }, { "Mudland", mud.getMesh(0) } }, 20);
+		ofExit(failures == 0 ? 0 : 1);
+	}
 }
 
 // listeners for gui
 void ofApp::restart() {
 	bRunGame = false;
 	explode = false;
-	startTime = 0.0;
 	fuelUse = 0.0;
 	score = 0.0;
 	correctLanding = 0.0;
@@ -171,18 +229,28 @@ void ofApp::restart() {
 	velocity = glm::vec3(0, 0, 0);
 }
 
+// render as fast as possible, the physics rate stays the same
+//
+void ofApp::setUncapped(bool& val) {
+	ofSetVerticalSync(!val);
+	ofSetFrameRate(val ? 0 : 60);
+}
+
 void ofApp::switchMars(bool& val) {
 	if (val) {
 		bRunGame = false;
 		explode = false;
 
-		octree = octreeMars;
-		terrain = mars;
+		octree = &octreeMars;
+		partQuery = QueryExecutor(*octree, pool.get());
+		heightGrid = &gridMars;
+		groundHit = RayHit();
+		terrain = &mars;
 		gravity = 3.71;
 		acceleration = glm::vec3(0, -gravity, 0);
 		velocity = glm::vec3(0, 0, 0);
 
-		startingY = octree.height;
+		startingY = octree->height;
 		lander.setPosition(0, startingY, 0);
 		landerYOffset = 0;
 
@@ -191,7 +259,6 @@ void ofApp::switchMars(bool& val) {
 		hardnessScale = gravity * 0.9;
 
 		explode = false;
-		startTime = 0.0;
 		fuelUse = 0.0;
 		score = 0.0;
 		correctLanding = 0.0;
@@ -206,13 +273,16 @@ void ofApp::switchMoon(bool& val) {
 		bRunGame = false;
 		explode = false;
 
-		octree = octreeMoon;
-		terrain = moon;
+		octree = &octreeMoon;
+		partQuery = QueryExecutor(*octree, pool.get());
+		heightGrid = &gridMoon;
+		groundHit = RayHit();
+		terrain = &moon;
 		gravity = 1.62;
 		acceleration = glm::vec3(0, -gravity, 0);
 		velocity = glm::vec3(0, 0, 0);
 
-		startingY = octree.height + 100;
+		startingY = octree->height + 100;
 		lander.setPosition(0, startingY, 0);
 		landerYOffset = 0;
 
@@ -221,7 +291,6 @@ void ofApp::switchMoon(bool& val) {
 		hardnessScale = gravity * 0.9;
 
 		explode = false;
-		startTime = 0.0;
 		fuelUse = 0.0;
 		score = 0.0;
 		correctLanding = 0.0;
@@ -236,13 +305,16 @@ void ofApp::switchMud(bool& val) {
 		bRunGame = false;
 		explode = false;
 
-		octree = octreeMud;
-		terrain = mud;
+		octree = &octreeMud;
+		partQuery = QueryExecutor(*octree, pool.get());
+		heightGrid = &gridMud;
+		groundHit = RayHit();
+		terrain = &mud;
 		gravity = 4.20;
 		acceleration = glm::vec3(0, -gravity, 0);
 		velocity = glm::vec3(0, 0, 0);
 
-		startingY = octree.height;
+		startingY = octree->height;
 		lander.setPosition(0, startingY, 0);
 		landerYOffset = 7;
 
@@ -251,7 +323,6 @@ void ofApp::switchMud(bool& val) {
 		hardnessScale = gravity * 0.9;
 
 		explode = false;
-		startTime = 0.0;
 		fuelUse = 0.0;
 		score = 0.0;
 		correctLanding = 0.0;
@@ -268,9 +339,36 @@ void ofApp::update() {
 	currentNumLevels = numLevels;
 
 	if (bLanderLoaded) {
-		glm::vec3 landerPos = lander.getPosition(); // current lander position
-		ofVec3f min, max;
-		Box bounds;
+		// moved outside the simulation (restart, map switch, drag): nothing to
+		// interpolate from
+		if (lander.getPosition() != simPosition) {
+			prevPosition = lander.getPosition();
+			prevRotation = rotation;
+		}
+
+		// fixed timestep: the real time of the last frame is simulated in ticks
+		// of 1 / physicsRate, whatever the frame rate.  A hitch is cut to
+		// maxFrameTime, so it costs a bounded number of ticks instead of one
+		// huge step
+		float dt = 1.0 / physicsRate;
+		accumulator += std::min((float)ofGetLastFrameTime(), maxFrameTime);
+		ticks = 0;
+		while (accumulator >= dt) {
+			prevPosition = lander.getPosition();
+			prevRotation = rotation;
+			simulate(dt);
+			accumulator -= dt;
+			simTime += dt;
+			ticks++;
+		}
+		simPosition = lander.getPosition();
+		startParticles();
+
+		// render state: between the last two ticks
+		float alpha = accumulator / dt;
+		renderPosition = glm::mix(prevPosition, simPosition, alpha);
+		renderRotation = glm::mix(prevRotation, rotation, alpha);
+		glm::vec3 landerPos = renderPosition;
 
 		//2 cams
 		fixedCam.lookAt(glm::vec3(landerPos.x, landerPos.y, landerPos.z));
@@ -291,207 +389,305 @@ void ofApp::update() {
 			LLander.disable();
 		}
 
-		//1
-		thrustEmitter();
-		// Update and remove dead particles
-		auto it = particles.begin();
-		while (it != particles.end()) {
-			it->update();
-			if (it->isDead()) {
-				it = particles.erase(it);
-			}
-			else {
-				++it;
-			}
-		}
-
-		// altitude calculation
-		// ray from lander straight down
-		Vector3 rayOrig = Vector3(landerPos.x, landerPos.y, landerPos.z);
-		Ray ray = Ray(rayOrig, Vector3(0, -1, 0));
-
-		// find ground level node
-		octree.intersect(ray, octree.root, groundNode);
-
-		// compare lander and ground height
-		if (!groundNode.points.empty()) {
-			float landerY = landerPos.y + landerYOffset; // offset for certain maps
-			float groundY = octree.mesh.getVertex(groundNode.points[0]).y;
-			altitude = landerY - groundY;
-		}
-
 		// Fuel
 		fuelUsed = "Fuel: " + to_string((fuelTime - (fuelUse / 10)) / 100.0) + " sec";
 
-		// collision effect
-		if (colBoxList.size() >= 5) {
-			if (!bGrounded) {
-				// velocity value used later
-				float vMagnitude = abs(velocity.x) + abs(velocity.y) + abs(velocity.z);
-				float yForce = -velocity.y;
-
-				min = lander.getSceneMin() + landerPos;
-				max = lander.getSceneMax() + landerPos;
-				bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-
-				// check if intersect with landing box - otherwise crash land
-				bool landed = false;
-				for (Box landing : octree.landingAreas) {
-					if (landing.overlap(bounds)) {
-						landed = true;
-						break;
-					}
-				}
+		// play sound
+		if (!muteSound) {
+			if (bPlayerInput && !thrustSound.isPlaying()) thrustSound.play();
+			else if (!bPlayerInput && thrustSound.isPlaying()) thrustSound.stop();
+		}
+		else if (thrustSound.isPlaying()) thrustSound.stop();
+	}
+}
 
-				if (!landed) crashLanding++;
-				if (vMagnitude > hardnessScale) {
-					// check if velocity of lander surpasses threshold for hard landing - even outside landing area
-					// CALL EXPLOSION FUNCTION HERE - tbh still unsure about value for 'hard' so feel free to change it
-					if (landed) hardLanding++;
-					explode = true;
-					acceleration = glm::vec3(ofRandom(-100, 100) * 5.0, ofRandom(100, 200) * 3.0, ofRandom(-100, 100) * 5.0);
-					angularVelocity = ofRandom(-1000.0, 1000.0);
-				}
-				else if (landed) {
-					correctLanding++;
-				}
+//--------------------------------------------------------------
+// one physics tick of dt seconds: emitter, altitude, collision response and
+// integration of the lander
+//
+void ofApp::simulate(float dt) {
+	glm::vec3 landerPos = lander.getPosition(); // current lander position
+	ofVec3f min, max;
+	Box bounds;
+
+	// forces of the keys held, then burn fuel while thrusting
+	applyPlayerInput();
+	if (bRunGame && bPlayerInput) fuelUse += dt * 1000;
+
+	//1 particles of this tick, emitted and stepped by startParticles()
+	emitterTicks.push_back({ landerPos, explode, bPlayerInput, colQuery.hits });
+
+	// altitude calculation
+	// ray from lander straight down
+	Vector3 rayOrig = Vector3(landerPos.x, landerPos.y, landerPos.z);
+	Ray ray = Ray(rayOrig, Vector3(0, -1, 0));
+
+	// find closest ground hit, from the heightfield grid or an octree ray -
+	// neither may allocate in steady state, builds with
+	// SPACELANDER_COUNT_ALLOCS verify it
+	size_t allocs = allocCount();
+	RayHit hit;
+	bool ground = gridAltitude && !heightGrid->empty()
+		? heightGrid->altitude(landerPos, hit)
+		: octree->intersect(ray, hit, groundCache);
+	if (ground) groundHit = hit;
+	size_t rayAllocs = allocCount() - allocs;
+
+	// compare lander and ground height
+	if (groundHit.hit()) {
+		float landerY = landerPos.y + landerYOffset; // offset for certain maps
+		altitude = landerY - groundHit.point.y;
+	}
 
-				if (!explode) {
-					// stop movement on lander so it doesn't move through terrain
-					bGrounded = true;
-					velocity = glm::vec3(0, 0, 0);
-					acceleration = glm::vec3(0, 0, 0);
-
-					// decrease magnitude of bounce if there are multiple
-					timeSinceLastBounce = ofGetElapsedTimeMillis() - timeSinceLastBounce;
-					if (!bPlayerInput && timeSinceLastBounce < 5000) bounceFactor = (bounceFactor >= 10) ? bounceFactor - 10 : 0;
-					else bounceFactor = 100;
-
-					// calculate bounce direction based on collision points
-					glm::vec3 bounceVector = glm::vec3(0, 0, 0);
-					for (int point : colPoints) {
-						// get vector from collision point to lander
-						glm::vec3 p = landerPos - octree.mesh.getVertex(point);
-						bounceVector += glm::vec3(p.x, -p.y, p.z);
-					}
-					bounceVector = glm::normalize(bounceVector / colPoints.size()); // average vectors
-
-					bounceVector.y *= yForce;
-					force = bounceVector * bounceFactor * (ofGetFrameRate() / 100);
+	// collision effect - the lander box (or one of its parts) overlaps
+	// terrain triangles, or the last step's sweep stopped it on the terrain
+	bool contact = partCollision ? partHit >= 0 : !manifold.empty();
+	if (contact || sweepHit.hit()) {
+		if (!bGrounded) {
+			// velocity value used later
+			float vMagnitude = abs(velocity.x) + abs(velocity.y) + abs(velocity.z);
+			float yForce = -velocity.y;
+
+			min = lander.getSceneMin() + landerPos;
+			max = lander.getSceneMax() + landerPos;
+			bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+
+			// check if intersect with landing box - otherwise crash land
+			bool landed = false;
+			for (const Box& landing : octree->landingAreas) {
+				if (landing.overlap(bounds)) {
+					landed = true;
+					break;
 				}
 			}
-		}
-		else {
-			bGrounded = false;
-			timeSinceLastBounce = ofGetElapsedTimeMillis();
-			acceleration = glm::vec3(0, -gravity, 0);
-		}
 
-		if (!explode && (correctLanding > 0.0)) {
-			score = (correctLanding * 5) + (hardLanding * 1) + (crashLanding * -1);
-		}
+			if (!landed) crashLanding++;
+			if (vMagnitude > hardnessScale) {
+				// check if velocity of lander surpasses threshold for hard landing - even outside landing area
+				// CALL EXPLOSION FUNCTION HERE - tbh still unsure about value for 'hard' so feel free to change it
+				if (landed) hardLanding++;
+				explode = true;
+				acceleration = glm::vec3(explosionRng.uniform(-100, 100) * 5.0, explosionRng.uniform(100, 200) * 3.0, explosionRng.uniform(-100, 100) * 5.0);
+				angularVelocity = explosionRng.uniform(-1000.0, 1000.0);
+			}
+			else if (landed) {
+				correctLanding++;
+			}
 
-		// integrate lander
-		if (bRunGame) integrate();
+			if (!explode) {
+				// stop movement on lander so it doesn't move through terrain
+				bGrounded = true;
+				velocity = glm::vec3(0, 0, 0);
+				acceleration = glm::vec3(0, 0, 0);
+
+				// decrease magnitude of bounce if there are multiple
+				timeSinceLastBounce = simTime * 1000 - timeSinceLastBounce;
+				if (!bPlayerInput && timeSinceLastBounce < 5000) bounceFactor = (bounceFactor >= 10) ? bounceFactor - 10 : 0;
+				else bounceFactor = 100;
+
+				// bounce along the terrain normals of the contact manifold,
+				// or of the swept / part contact when the box itself does
+				// not reach the terrain
+				glm::vec3 bounceVector = manifold.normal();
+				if (manifold.empty() && sweepHit.hit()) bounceVector = sweepHit.normal;
+				else if (manifold.empty() && partHit >= 0 && partFace >= 0) bounceVector = octree->faceNormal(partFace, landerPos);
+				else if (manifold.empty()) bounceVector = glm::vec3(0, 1, 0);
+
+				// applied for one tick: the same impulse at any physics rate
+				bounceVector.y *= yForce;
+				force = bounceVector * bounceFactor / (dt * 100);
+			}
+		}
+	}
+	else {
+		bGrounded = false;
+		timeSinceLastBounce = simTime * 1000;
+		acceleration = glm::vec3(0, -gravity, 0);
+	}
 
-		// update collision detection
-		min = lander.getSceneMin() + lander.getPosition();
-		max = lander.getSceneMax() + lander.getPosition();
-		bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	if (!explode && (correctLanding > 0.0)) {
+		score = (correctLanding * 5) + (hardLanding * 1) + (crashLanding * -1);
+	}
 
-		colBoxList.clear();
-		colPoints.clear();
-		octree.intersect(bounds, octree.root, colBoxList, colPoints);
+	// integrate lander
+	sweepHit = SweepHit();
+	if (bRunGame) integrate(dt);
+
+	// update collision detection
+	min = lander.getSceneMin() + lander.getPosition();
+	max = lander.getSceneMax() + lander.getPosition();
+	bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+
+	size_t boxAllocs = allocCount();
+	octree->intersect(bounds, colQuery, colCache);
+	octree->contacts(bounds, manifold, colCache);
+	octreeAllocs = (allocCount() - boxAllocs) + rayAllocs;
+	if (octreeAllocs > 0) {
+		ofLogVerbose("ofApp") << "octree queries allocated " << octreeAllocs << " times this tick (box query: "
+			<< colQuery.visited << " nodes visited, " << colQuery.hits << " hits, high water " << colQuery.highWater << ")";
+	}
 
-		// play sound
-		if (!muteSound) {
-			if (bPlayerInput && !thrustSound.isPlaying()) thrustSound.play();
-			else if (!bPlayerInput && thrustSound.isPlaying()) thrustSound.stop();
+	// per part collision: the box of every lander mesh, placed like the
+	// drawn bboxList, is tested against the terrain in parallel (serially on
+	// a lazy tree, which grows as it is queried)
+	partHit = -1;
+	if (partCollision) {
+		glm::mat4 model = lander.getModelMatrix();
+		model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1, 0, 0)); // correct model orientation
+		partBoxes.clear();
+		for (const Box& part : bboxList) {
+			partBoxes.push_back(OrientedBox(part, model));
 		}
+		partHit = partQuery.overlapAny(partBoxes, partFace);	// one after the other through octree->overlap() on a lazy tree
 	}
 }
 
 //1
-void ofApp::thrustEmitter() {
-	if (!bLanderLoaded) { return; }
-
-	float radius = 0.45; // Adjust the radius as needed
-	float lifeSpan = 25.0; // Adjust the lifespan as needed
-	float amount = 100; // Adjust the amount as needed
-	float evenSpacedAmount = 20;
-	float speed = 0.05; // Adjust the speed as needed
-	ofVec3f landerPos = lander.getPosition();
-	float yOffset = 0.4f;
-	ofVec3f center(landerPos.x, landerPos.y + yOffset, landerPos.z);
-
-	if (explode) {
-		// Initial Explosion
-		if (colBoxList.size() > 2) {
-			radius = 20.0;
-			yOffset = 1.0;
-		}
+// emits the particles of one tick into the pool, in chunks on workers.  The
+// lifespan drifts from one particle to the next, so a chunk walks it from 0
+// and the chunks' walks are added up in order once they are done
+//
+void ofApp::thrustEmitter(const EmitterTick& tick, uint64_t step, ThreadPool* workers) {
+	if (!tick.explode && !tick.thrust) { return; }
+
+	const int grain = 32; // particles per emitter task
+	int amount = 100; // Adjust the amount as needed
+	int first = particles.claim(amount);
+
+	forEachChunk(workers, amount, grain, [&](int begin, int end) {
+		// the chunk's random numbers in one bulk fill, four per particle
+		Rng rng(seed, rngStream(RngParticles, step * 256 + begin / grain));
+		float random[4 * grain];
+		rng.fill(random, 4 * (end - begin));
+
+		float radius = 0.45; // Adjust the radius as needed
+		float lifeSpan = 0;
+		float evenSpacedAmount = 20;
+		float speed = 0.05; // Adjust the speed as needed
+		glm::vec3 landerPos = tick.landerPos;
+		float yOffset = 0.4f;
+		ofVec3f center(landerPos.x, landerPos.y + yOffset, landerPos.z);
+
+		if (tick.explode) {
+			// Initial Explosion
+			if (tick.hits > 2) {
+				radius = 20.0;
+				yOffset = 1.0;
+			}
+
+			//Trail
+			radius = 1.5;
+			yOffset = 1.8;
+			for (int i = begin; i < end; ++i) {
+				const float* r = &random[4 * (i - begin)];
+				float angle = ofDegToRad(Rng::range(r[0], 0, 360));
+				float x, z;
+				float y = 0;
+				ofVec3f direction;
+				float randomAngle;
+
+				if (i < evenSpacedAmount) {
+					x = radius * cos(angle);
+					z = radius * sin(angle);
+					randomAngle = Rng::range(r[1], -60, 60);
+					lifeSpan += Rng::range(r[2], -2.5, 5.0);
+				}
+				else {
+					float distance = Rng::range(r[3], 0, radius);
+					x = distance * cos(angle);
+					z = distance * sin(angle);
+					randomAngle = Rng::range(r[1], -40, 40);
+					lifeSpan += Rng::range(r[2], -1.0, 5.0);
+				}
 
-		//Trail
-		radius = 1.5;
-		yOffset = 1.8;
-		for (int i = 0; i < amount; ++i) {
-			float angle = ofDegToRad(ofRandom(0, 360));
-			float x, z;
-			float y = 0;
-			ofVec3f direction;
-			float randomAngle;
-
-			if (i < evenSpacedAmount) {
-				x = radius * cos(angle);
-				z = radius * sin(angle);
-				randomAngle = ofRandom(-60, 60);
-				lifeSpan += ofRandom(-2.5, 5.0);
+				direction = ofVec3f(x, y + yOffset + 1, z);
+				x += landerPos.x;
+				y += landerPos.y + yOffset;
+				z += landerPos.z;
+				particles.set(first + i, x, y, z, lifeSpan, speed, direction);
 			}
-			else {
-				float distance = ofRandom(0, radius);
-				x = distance * cos(angle);
-				z = distance * sin(angle);
-				randomAngle = ofRandom(-40, 40);
-				lifeSpan += ofRandom(-1.0, 5.0);
+		} else {
+			for (int i = begin; i < end; ++i) {
+				const float* r = &random[4 * (i - begin)];
+				float angle = ofDegToRad(Rng::range(r[0], 0, 360));
+				float x, z;
+				float y = 0;
+				ofVec3f direction;
+				float randomAngle;
+
+				if (i < evenSpacedAmount) {
+					x = radius * cos(angle);
+					z = radius * sin(angle);
+					randomAngle = Rng::range(r[1], -40, 40);
+					lifeSpan += Rng::range(r[2], -2.5, 1.0);
+				}
+				else {
+					float distance = Rng::range(r[3], 0, radius);
+					x = distance * cos(angle);
+					z = distance * sin(angle);
+					randomAngle = Rng::range(r[1], -20, 20);
+					lifeSpan += Rng::range(r[2], -1.0, 1.0);
+				}
+
+				direction = (center - ofVec3f(x, y, z)).getNormalized();
+				ofVec3f randomOffset(cos(ofDegToRad(randomAngle)), 0, sin(ofDegToRad(randomAngle)));
+				direction += randomOffset * 0.2;
+				x += landerPos.x;
+				y += landerPos.y + yOffset;
+				z += landerPos.z;
+				particles.set(first + i, x, y, z, lifeSpan, speed, direction);
 			}
+		}
+	});
 
-			direction = ofVec3f(x, y + yOffset + 1, z);
-			x += landerPos.x;
-			y += landerPos.y + yOffset;
-			z += landerPos.z;
-			particles.emplace_back(x, y, z, lifeSpan, speed, direction);
+	float carry = 25.0; // Adjust the lifespan as needed
+	for (int begin = 0; begin < amount; begin += grain) {
+		int end = std::min(begin + grain, amount);
+		for (int i = begin; i < end; i++) {
+			particles.life[first + i] += carry;
 		}
-	} else if (bPlayerInput) {
-		for (int i = 0; i < amount; ++i) {
-			float angle = ofDegToRad(ofRandom(0, 360));
-			float x, z;
-			float y = 0;
-			ofVec3f direction;
-			float randomAngle;
-
-			if (i < evenSpacedAmount) {
-				x = radius * cos(angle);
-				z = radius * sin(angle);
-				randomAngle = ofRandom(-40, 40);
-				lifeSpan += ofRandom(-2.5, 1.0);
-			}
-			else {
-				float distance = ofRandom(0, radius);
-				x = distance * cos(angle);
-				z = distance * sin(angle);
-				randomAngle = ofRandom(-20, 20);
-				lifeSpan += ofRandom(-1.0, 1.0);
-			}
+		carry = particles.life[first + end - 1];
+	}
+}
 
-			direction = (center - ofVec3f(x, y, z)).getNormalized();
-			ofVec3f randomOffset(cos(ofDegToRad(randomAngle)), 0, sin(ofDegToRad(randomAngle)));
-			direction += randomOffset * 0.2;
-			x += landerPos.x;
-			y += landerPos.y + yOffset;
-			z += landerPos.z;
-			particles.emplace_back(x, y, z, lifeSpan, speed, direction);
+// emit and step the particles of this frame's ticks, then collide them with
+// the terrain.  With parallel particles this runs as a job on the pool while
+// the main thread finishes the frame; draw() joins it before it draws them
+//
+void ofApp::startParticles() {
+	finishParticles();
+	particleTicks.swap(emitterTicks);
+	emitterTicks.clear();
+	if (particleTicks.empty()) return;
+
+	ThreadPool* workers = parallelParticles ? pool.get() : nullptr;
+	const HeightGrid* grid = particleCollision ? heightGrid : nullptr; // the map may switch while the job runs
+	particleCollider.bounce = particlesBounce;
+	auto job = [this, workers, grid] {
+		for (const EmitterTick& tick : particleTicks) {
+			thrustEmitter(tick, particleStep++, workers);
+			// Update and remove dead particles
+			particles.update(workers);
 		}
+		if (grid) particleCollider.collide(particles, *grid, workers);
+	};
+	if (workers) {
+		bParticleJob = true;
+		pool->run(particleJob, job);
 	}
+	else job();
+}
+
+void ofApp::finishParticles() {
+	if (!bParticleJob) return;
+	pool->wait(particleJob);
+	bParticleJob = false;
+}
+
+// the particle job must not outlive the pool and the particles
+//
+void ofApp::exit() {
+	finishParticles();
 }
 
 //--------------------------------------------------------------
@@ -527,26 +723,29 @@ void ofApp::draw() {
 	if (bWireframe) {                    // wireframe mode  (include axis)
 		ofDisableLighting();
 		ofSetColor(ofColor::slateGray);
-		terrain.drawWireframe();
+		terrain->drawWireframe();
 	}
 	else {
 		ofPushMatrix();
 		ofEnableLighting();              // shaded mode
-		terrain.drawFaces();
+		terrain->drawFaces();
 		ofMesh mesh;
 
 		// draw landing areas
-		for (Box landing : octree.landingAreas) {
+		for (const Box& landing : octree->landingAreas) {
 			ofNoFill();
 			ofSetColor(ofColor::green);
 			Octree::drawBox(landing);
 		}
 
 		if (bLanderLoaded) {
-			glm::vec3 landerPos = lander.getPosition();
+			// drawn between the last two physics ticks, then put back
+			glm::vec3 simPos = lander.getPosition();
+			glm::vec3 landerPos = renderPosition;
+			lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
+			lander.setRotation(1, renderRotation, 0, 1, 0);
 
 			ofPushMatrix();
-			lander.setRotation(1, rotation, 0, 1, 0);
 			lander.drawFaces();
 			ofPopMatrix();
 
@@ -573,19 +772,22 @@ void ofApp::draw() {
 
 				// draw colliding boxes
 				ofSetColor(ofColor::lightBlue);
-				for (int i = 0; i < colBoxList.size(); i++) {
-					Octree::drawBox(colBoxList[i]);
+				for (const Box& box : colQuery.boxes) {
+					Octree::drawBox(box);
 				}
 			}
 
 			// physical representation of altitude from ground level
-			if (displayAltitude && !groundNode.points.empty()) {
+			if (displayAltitude && groundHit.hit()) {
 				glm::vec3 groundPos = landerPos;
-				groundPos.y = octree.mesh.getVertex(groundNode.points[0]).y - landerYOffset; // offset
+				groundPos.y = groundHit.point.y - landerYOffset; // offset
 
 				ofSetColor(ofColor::red);
 				ofDrawLine(landerPos, groundPos);
 			}
+
+			lander.setPosition(simPos.x, simPos.y, simPos.z);
+			lander.setRotation(1, rotation, 0, 1, 0);
 		}
 	}
 
@@ -595,14 +797,19 @@ void ofApp::draw() {
 	
 	ofFill();
 	//1 Draw particles
-	for (auto& particle : particles) {
-		particle.draw();
+	finishParticles();
+	ofSetColor(ofColor::yellow);
+	if (batchParticles) particleRenderer.draw(particles);
+	else {
+		for (int i = 0; i < particles.size(); i++) {
+			ofDrawSphere(particles.position(i), 0.01); // Adjust the sphere radius as needed
+		}
 	}
 	ofNoFill();
 
 	if (bDisplayOctree) {
 		ofNoFill();
-		octree.draw(currentNumLevels, 0);
+		octree->draw(currentNumLevels, 0);
 	}
 	ofPopMatrix();
 	curCam->end();
@@ -650,6 +857,7 @@ void ofApp::draw() {
 		ofDrawBitmapString("F3 for free camera", xOff, yOff + padding * 14);
 		ofDrawBitmapString("z to toggle free camera to face lander", xOff, yOff + padding * 15);
 		ofDrawBitmapString("c to toggle free camera movement", xOff, yOff + padding * 16);
+		ofDrawBitmapString("p to print collision cache hit rates", xOff, yOff + padding * 17);
 
 		ofDrawBitmapString("Lander Controls:", xOff + padding * 17, yOff + padding * 11);
 		ofDrawBitmapString("Spacebar to move upward", xOff + padding * 17, yOff + padding * 12);
@@ -729,6 +937,11 @@ void ofApp::keyPressed(int key) {
 	case 'o':
 		bDisplayOctree = !bDisplayOctree;
 		break;
+	case 'P':
+	case 'p':
+		cout << "lander coherence: altitude ray " << groundCache.hitRate() * 100 << "% of " << groundCache.queries
+			<< " queries, collision box " << colCache.hitRate() * 100 << "% of " << colCache.queries << endl;
+		break;
 	case 'R':
 	case 'r':
 		freeCam.reset();
@@ -745,28 +958,19 @@ void ofApp::keyPressed(int key) {
 		else bLookAtLander = true;
 		break;
 	case ' ': // lander moves upward
-		if (bPlayerInput) { fuelUse += ofGetElapsedTimeMillis() - startTime; }
-		if (bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0) {
-			force = glm::vec3(0, gravity * 10, 0);
-			bPlayerInput = true;
-			startTime = ofGetElapsedTimeMillis();
-		}
+		bThrustKey = true;
 		break;
 	case OF_KEY_UP: // lander moves forwards
-		if (bPlayerInput) { fuelUse += ofGetElapsedTimeMillis() - startTime; }
-		if (bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0) moveLander(1); bPlayerInput = true; startTime = ofGetElapsedTimeMillis();
+		bForwardKey = true;
 		break;
 	case OF_KEY_DOWN: // lander moves backwards
-		if (bPlayerInput) { fuelUse += ofGetElapsedTimeMillis() - startTime; }
-		if (bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0) moveLander(-1); bPlayerInput = true; startTime = ofGetElapsedTimeMillis();
+		bBackwardKey = true;
 		break;
 	case OF_KEY_LEFT: // lander rotates counter-clockwise
-		if (bPlayerInput) { fuelUse += ofGetElapsedTimeMillis() - startTime; }
-		if (bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0) rotateLander(1); bPlayerInput = true; startTime = ofGetElapsedTimeMillis();
+		bLeftKey = true;
 		break;
 	case OF_KEY_RIGHT: // lander rotates clockwise
-		if (bPlayerInput) { fuelUse += ofGetElapsedTimeMillis() - startTime; }
-		if (bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0) rotateLander(-1); bPlayerInput = true; startTime = ofGetElapsedTimeMillis();
+		bRightKey = true;
 		break;
 	case OF_KEY_F1:
 		curCam = &fixedCam;
@@ -789,15 +993,19 @@ void ofApp::keyPressed(int key) {
 void ofApp::keyReleased(int key) {
 	switch (key) {
 	case ' ': // lander moves upward
+		bThrustKey = false;
+		break;
 	case OF_KEY_UP:
+		bForwardKey = false;
+		break;
 	case OF_KEY_DOWN:
+		bBackwardKey = false;
+		break;
 	case OF_KEY_LEFT:
+		bLeftKey = false;
+		break;
 	case OF_KEY_RIGHT:
-		thrustSound.stop();
-		if (bPlayerInput) {
-			bPlayerInput = false;
-			fuelUse += ofGetElapsedTimeMillis() - startTime;
-		}
+		bRightKey = false;
 		break;
 	case OF_KEY_ALT:
 		freeCam.disableMouseInput();
@@ -864,8 +1072,7 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
 		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
 
-		colBoxList.clear();
-		octree.intersect(bounds, octree.root, colBoxList, colPoints);
+		octree->intersect(bounds, colQuery, colCache);
 	}
 }
 
@@ -1028,21 +1235,46 @@ glm::vec3 ofApp::heading() {
 }
 
 // apply linear force along heading (direction = forward/backward)
-void ofApp::moveLander(int dir) {
-	force = heading() * 10 * dir;
+void ofApp::moveLander(float dir) {
+	force += heading() * 10 * dir;
 }
 
 // apply angular force (direction = counter/clockwise)
-void ofApp::rotateLander(int dir) {
-	angularForce = 50 * dir;
+void ofApp::rotateLander(float dir) {
+	angularForce += 50 * dir;
 }
 
-void ofApp::integrate() {
-	// calculate time interval
-	float dt = 1.0 / ofGetFrameRate();
+// forces of the keys held down, for one physics tick.  integrate() clears
+// them again, so a key pushes the lander the same every second at any
+// physics rate, key repeat rate or frame rate.  The forces were tuned when
+// every OS key repeat event pushed for one 60 Hz frame: scaled by
+// keyRepeatRate / 60 a held key gives that same average push
+//
+void ofApp::applyPlayerInput() {
+	int move = (int)bForwardKey - (int)bBackwardKey;
+	int turn = (int)bLeftKey - (int)bRightKey;
+	bool hasFuel = bRunGame && ((fuelTime - (fuelUse / 10)) / 100.0) > 0.0;
+	bPlayerInput = hasFuel && (bThrustKey || move != 0 || turn != 0);
+	if (!bPlayerInput) return;
+
+	float scale = keyRepeatRate / 60;
+	if (bThrustKey) force += glm::vec3(0, gravity * 10, 0) * scale;
+	if (move != 0) moveLander(move * scale);
+	if (turn != 0) rotateLander(turn * scale);
+}
 
-	// update position from velocity & time interval
-	ofVec3f pos = lander.getPosition() + (velocity * dt);
+void ofApp::integrate(float dt) {
+	// update position from velocity & time interval.  With continuous
+	// collision the lander's box is swept along the step and stops where it
+	// first touches the terrain, so it cannot pass through it at any dt
+	glm::vec3 motion = velocity * dt;
+	if (continuousCollision) {
+		glm::vec3 min = lander.getSceneMin() + lander.getPosition();
+		glm::vec3 max = lander.getSceneMax() + lander.getPosition();
+		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+		if (octree->sweep(bounds, motion, sweepHit)) motion *= sweepHit.t;
+	}
+	ofVec3f pos = lander.getPosition() + motion;
 	lander.setPosition(pos.x, pos.y, pos.z);
 
 	// update velocity (from acceleration)
@@ -1052,15 +1284,17 @@ void ofApp::integrate() {
 
 	// update rotation from angular velocity & time
 	rotation += angularVelocity * dt;
+	lander.setRotation(1, rotation, 0, 1, 0);
 
 	// update angular velocity (from angular acceleration)
 	float angAccel = angularAcceleration;
 	angAccel += angularForce / mass;
 	angularVelocity += angAccel * dt;
 
-	// multiply final result by the damping factor to sim drag
-	velocity *= damping;
-	angularVelocity *= angularDamping;
+	// multiply final result by the damping factor to sim drag.  The factors
+	// are per 60 Hz tick, so the drag per second is the same at any rate
+	velocity *= pow(damping, dt * 60);
+	angularVelocity *= pow(angularDamping, dt * 60);
 
 	// reset all forces
 	force = glm::vec3(0, 0, 0);
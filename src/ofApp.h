@@ -4,7 +4,11 @@
 #include "ofxGui.h"
 #include  "ofxAssimpModelLoader.h"
 #include "Octree.h"
-#include "ParticleCustom.h"
+#include "QueryExecutor.h"
+#include "HeightGrid.h"
+#include "ParticleRenderer.h"
+#include "ParticleCollider.h"
+#include "Random.h"
 #include <glm/gtx/intersect.hpp>
 #include <glm/glm.hpp>
 
@@ -14,6 +18,7 @@ public:
 	void setup();
 	void update();
 	void draw();
+	void exit();
 
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -35,9 +40,15 @@ public:
 
 
 	ofxAssimpModelLoader mars, moon, mud;
-	ofxAssimpModelLoader terrain; // current terrain
+	ofxAssimpModelLoader* terrain; // current terrain
 	Octree octreeMars, octreeMoon, octreeMud;
-	Octree octree; // current terrain's octree
+	Octree* octree; // current terrain's octree
+	HeightGrid gridMars, gridMoon, gridMud; // heightfield grids for the altitude sensor
+	HeightGrid* heightGrid; // current terrain's grid
+	bool bLazyOctree = false; // subdivide the terrain octrees on demand
+	bool bRunBenchmarks = false; // --benchmark: run them after setup, then exit
+	unique_ptr<ThreadPool> pool;
+	int numThreads = 0; // worker threads, 0 = one per core
 	int currentNumLevels;
 	vector<Box> bboxList;
 
@@ -56,6 +67,15 @@ public:
 	ofxButton restartGame;
 	ofParameter<bool> muteSound;
 	ofParameter<bool> displayAltitude;
+	ofParameter<bool> continuousCollision; // sweep the lander box along each step
+	ofParameter<bool> partCollision; // oriented box per lander mesh instead of one scene AABB
+	ofParameter<bool> gridAltitude; // altitude from the heightfield grid instead of an octree ray
+	ofxIntSlider physicsRate; // simulation ticks per second
+	ofParameter<bool> uncappedFrameRate; // no vsync or frame rate limit
+	ofParameter<bool> batchParticles; // particles as points from one buffer instead of a sphere each
+	ofParameter<bool> parallelParticles; // particle work as chunked jobs on the thread pool, overlapping the frame
+	ofParameter<bool> particleCollision; // particles stop at the terrain
+	ofParameter<bool> particlesBounce; // particles that hit the terrain bounce, otherwise they die
 	ofxLabel fuelUsed;
 	ofxFloatSlider hardnessScale;
 	ofParameterGroup mapOptions;
@@ -65,9 +85,18 @@ public:
 	void switchMars(bool& val);
 	void switchMoon(bool& val);
 	void switchMud(bool& val);
+	void setUncapped(bool& val);
 
 	bool bRunGame;
-	bool bPlayerInput;
+	bool bPlayerInput = false; // thrusting, moving or rotating this tick
+
+	// keys held down: keyPressed()/keyReleased() only record them, simulate()
+	// applies their forces on every tick they are held
+	bool bThrustKey = false;
+	bool bForwardKey = false, bBackwardKey = false;
+	bool bLeftKey = false, bRightKey = false;
+	float keyRepeatRate = 30; // key repeat events per second the input forces were tuned with
+	void applyPlayerInput();
 	bool bAltKeyDown;
 	bool bHide;
 	bool bWireframe;
@@ -83,15 +112,23 @@ public:
 	//
 
 	glm::vec3 heading();
-	void integrate();
-	void moveLander(int dir);
-	void rotateLander(int dir);
+	void simulate(float dt);
+	void integrate(float dt);
+	void moveLander(float dir);
+	void rotateLander(float dir);
 
 	ofxAssimpModelLoader lander;
 	Box boundingBox, landerBounds;
 	ofLight LTerrain, LLander, LLander2;
-	vector<Box> colBoxList;
-	vector<int> colPoints;
+	QueryContext colQuery; // leaf boxes and points under the lander, storage reused every frame
+	QueryExecutor partQuery; // part boxes against the current octree
+	CoherenceCache colCache; // where last frame's lander box query started (box and contacts)
+	ContactManifold manifold; // contacts of the lander box with the terrain
+	SweepHit sweepHit; // first terrain contact of the last step (continuous collision)
+	vector<OrientedBox> partBoxes; // bboxList in world space (part collision)
+	int partHit = -1; // lander mesh touching the terrain, -1 for none
+	int partFace = -1; // triangle it touches
+	size_t octreeAllocs = 0; // heap allocations of last frame's octree queries
 	ofSoundPlayer thrustSound;
 	bool bLanderLoaded;
 	float startingY, gravity, bounceFactor, timeSinceLastBounce;
@@ -100,10 +137,21 @@ public:
 	bool explode = false;
 
 	// altitude sensor
-	TreeNode groundNode;
+	RayHit groundHit;
+	CoherenceCache groundCache; // where last frame's altitude ray started
 	float landerYOffset = 0;
 	float altitude = 0;
 
+	// fixed timestep: update() runs simulate() physicsRate times per second
+	// of real time at any frame rate, and draw() shows the lander between the
+	// last two ticks
+	float accumulator = 0; // real time not simulated yet (s)
+	double simTime = 0; // simulated time (s)
+	float maxFrameTime = 0.25; // longer frames (hitches) are cut to this
+	int ticks = 0; // ticks run by the last update()
+	glm::vec3 prevPosition = glm::vec3(0), simPosition = glm::vec3(0), renderPosition = glm::vec3(0);
+	float prevRotation = 0, renderRotation = 0;
+
 	// parameters for movement
 	glm::vec3 velocity = glm::vec3(0, 0, 0);
 	glm::vec3 acceleration = glm::vec3(0, 0, 0);
@@ -119,8 +167,29 @@ public:
 	float angularDamping = .99;
 
 	// Emitter
-	void thrustEmitter();
-	vector<Particle> particles;
+	// what the emitter sees at a physics tick - the particle job emits and
+	// steps the particles of the frame's ticks after them, off the main thread
+	struct EmitterTick {
+		glm::vec3 landerPos;
+		bool explode, thrust;
+		int hits; // colQuery.hits
+	};
+	void thrustEmitter(const EmitterTick& tick, uint64_t step, ThreadPool* workers);
+	void startParticles();
+	void finishParticles();
+	ParticlePool particles; // thrust and explosion particles, fixed capacity
+	ParticleRenderer particleRenderer;
+	ParticleCollider particleCollider; // against the current heightGrid, once per frame
+	vector<EmitterTick> emitterTicks; // ticks simulated this frame
+	vector<EmitterTick> particleTicks; // ticks the running particle job works through
+	TaskGroup particleJob;
+	bool bParticleJob = false; // particleJob is running: particles belong to it until finishParticles()
+	uint64_t particleStep = 0; // particle steps so far, each emits from its own Rng streams
+
+	// one seed for every random system: the same seed replays the same
+	// landing areas, explosions and particles.  0 picks one from the clock
+	uint64_t seed = 0;
+	Rng explosionRng;
 
 	// Cameras
 	ofCamera  fixedCam;
@@ -131,7 +200,6 @@ public:
 
 	// Fuel
 	float fuelUse = 0.0;
-	float startTime = 0.0;
 	float fuelTime = 2.0 * 6.0 * 1000.0;
 
 };